@@ -24,6 +24,9 @@
 #include <kernel/task.h>
 #include <arch/arch_task.h>
 #include <arch/cpu.h>
+#include <arch/arm.h>
+#include <arch/mmu.h>
+#include <arch/memory.h>
 
 #define ALIGNTO(x, y)    ((x) &= ~((y) - 1))
 
@@ -41,6 +44,9 @@ struct context_switch_frame {
 
 extern void arm_context_switch(unsigned long, unsigned long);
 
+/* switch the mm even when the page directory is the same, for ctxbench */
+int arch_force_switch_mm = 0;
+
 void arch_task_initialize(task_t *t)
 {
 
@@ -62,6 +68,28 @@ void arch_context_switch(task_t *oldtask, task_t *newtask)
 {
 	/* printk("oldtask->sp=0x%x, newtask->sp=0x%x\n", */
 	/*        oldtask->sp, newtask->sp); */
-	cpu_switch_mm((unsigned long)newtask->mm.pgd);
+	task_account_switch(oldtask, newtask);
+
+	/*
+	 * Switching the mm flushes the caches and the TLBs, only pay for
+	 * that when the address space really changes.
+	 */
+	if ((oldtask->mm.pgd != newtask->mm.pgd) || arch_force_switch_mm) {
+		cpu_switch_mm((unsigned long)newtask->mm.pgd);
+	}
 	arm_context_switch(&oldtask->sp, newtask->sp);
 }
+
+/* unmap the page below a stack so running off its end faults at once */
+void arch_task_guard_stack(void *guard)
+{
+	arm_mmu_unmap_page((addr_t)guard);
+}
+
+void arch_task_unguard_stack(void *guard)
+{
+	arm_mmu_map_page((addr_t)guard, virt_to_phys(guard),
+			 TTB_SPGTD_AP0_WR | TTB_SPGTD_AP1_WR |
+			 TTB_SPGTD_AP2_WR | TTB_SPGTD_AP3_WR |
+			 TTB_SPGTD_CACHEABLE | TTB_SPGTD_BUFFERABLE);
+}
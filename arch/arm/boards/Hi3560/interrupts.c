@@ -43,7 +43,7 @@ struct int_handler_struct {
 	void *arg;
 };
 
-static struct int_handler_struct int_handler_table[INTNR_IRQ_END];
+static struct int_handler_struct int_handler_table[INTNR_IRQ_END + 1];
 
 void platform_init_interrupts(void)
 {
@@ -81,17 +81,17 @@ int unmask_interrupt(unsigned int vector)
 
 handler_return platform_irq(struct arm_iframe *frame)
 {
-	unsigned int irq_num = 0;
+	unsigned int irq_num = INTNR_IRQ_START;
 	handler_return ret = INT_NO_RESCHEDULE;
 	// get the current irq status
 	unsigned int irq_status = readl(ioaddr_intc(REG_INTC_IRQSTATUS));
 
-	while(irq_status != 0)
+	/* every pending vector, and reschedule if any handler asks for it */
+	for (; irq_status != 0; irq_status >>= 1, irq_num++)
 	{
-		irq_status >>= 1;
-		irq_num ++;
-		if (int_handler_table[irq_num].handler)
-			ret = int_handler_table[irq_num].handler(int_handler_table[irq_num].arg);
+		if ((irq_status & 1) && int_handler_table[irq_num].handler &&
+		    (int_handler_table[irq_num].handler(int_handler_table[irq_num].arg) != INT_NO_RESCHEDULE))
+			ret = INT_RESCHEDULE;
 	}
 
 	return ret;
@@ -104,8 +104,10 @@ void platform_fiq(struct arm_iframe *frame)
 
 void register_int_handler(unsigned int vector, int_handler handler, void *arg)
 {
-	if (vector > INTNR_IRQ_END)
+	if (vector > INTNR_IRQ_END) {
 		printk("register_int_handler: vector out of range %d\n", vector);
+		return;
+	}
 
 	enter_critical_section();
 
@@ -21,7 +21,7 @@
  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 #include <arch/text.h>
-#include <kernel/semaphore.h>
+#include <kernel/mutex.h>
 #include <kernel/task.h>
 #include <arch/interrupts.h>
 #include <arch/platform.h>
@@ -33,7 +33,7 @@ volatile SERIAL_PORT uart = {
 	.puts	  = __puts_early,
 	.getchar  = __getchar_early,
 };
-DEFINE_SEMAPHORE(serial_sem);
+DEFINE_MUTEX(serial_lock);
 
 void __puts_early(const char *str)
 {
@@ -54,7 +54,7 @@ void __puts_early(const char *str)
 
 void __puts(const char *str)
 {
-	down(&serial_sem);
+	mutex_lock(&serial_lock);
 	while (*str) {
 		uart.fifo_out.mem[uart.fifo_out.wp] = *str;
 		uart.fifo_out.wp = (uart.fifo_out.wp + 1) % UART_FIFO_SIZE;
@@ -75,7 +75,7 @@ void __puts(const char *str)
 			break;
 		}
 	}
-	up(&serial_sem);
+	mutex_unlock(&serial_lock);
 }
 
 void putchar(char c)
@@ -107,10 +107,10 @@ unsigned char __getchar(void)
 
 	while(uart.fifo_in.rp == uart.fifo_in.wp);
 	
-	down(&serial_sem);
+	mutex_lock(&serial_lock);
 	data = uart.fifo_in.mem[uart.fifo_in.rp];
 	uart.fifo_in.rp = (uart.fifo_in.rp + 1) % UART_FIFO_SIZE;
-	up(&serial_sem);
+	mutex_unlock(&serial_lock);
 
 	return data;
 }
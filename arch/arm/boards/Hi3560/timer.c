@@ -22,6 +22,8 @@
  */
 #include <arch/timer.h>
 #include <kernel/task.h>
+#include <kernel/timer.h>
+#include <kernel/clocksource.h>
 #include <kernel/reg.h>
 #include <kernel/printk.h>
 #include <arch/memmap.h>
@@ -31,9 +33,24 @@
 #define DEFAULT_BUSCLK  110000000
 
 static platform_timer_callback t_callback;
-static unsigned long timer_reload = 0;
+static unsigned long timer_reload = 0;		/* counts per tick */
+static unsigned long timer_load = 0;		/* counts the running period was loaded with */
+static unsigned long timer_cycles_per_ms = 0;
+static unsigned long timer_oneshot_max = 0;	/* longest one-shot period in ms */
+static int timer_oneshot = 0;
+static int timer_phase = 0;			/* the one-shot only realigns the tick */
 
-static volatile unsigned long long ticks = 0;
+/* timer 1 of the pair runs free, counting down from ~0, as the clocksource */
+static unsigned long hi3560_clock_read(void)
+{
+	return ~readl(CFG_CLOCK_VABASE + REG_TIMER_VALUE);
+}
+
+static struct clocksource hi3560_clocksource = {
+	.name	= "timer1",
+	.read	= hi3560_clock_read,
+	.mask	= ~0UL,
+};
 
 unsigned long pllc_to_busclk(unsigned long pllc, unsigned long fxin)
 {
@@ -81,6 +98,22 @@ int platform_set_periodic_timer(platform_timer_callback callback, void *arg, tim
 		timer_reload = BUSCLK_TO_TIMER_RELOAD(DEFAULT_BUSCLK);
 	}
 	timer_reload = 6800000;
+	timer_load   = timer_reload;
+	timer_cycles_per_ms = timer_reload / (1000/HZ);
+
+	/* same clock as the tick, timer_reload counts per tick */
+	writel(0, CFG_CLOCK_VABASE + REG_TIMER_CONTROL);
+	writel(~0, CFG_CLOCK_VABASE + REG_TIMER_RELOAD);
+	writel(CFG_CLOCK_CONTROL, CFG_CLOCK_VABASE + REG_TIMER_CONTROL);
+	hi3560_clocksource.freq = timer_reload * HZ;
+	clocksource_register(&hi3560_clocksource);
+
+	/* the tick may not stay off for longer than the clocksource allows */
+	timer_oneshot_max = (~0UL - timer_cycles_per_ms) / timer_cycles_per_ms;
+	if (timer_oneshot_max > clocksource_max_idle_ms()) {
+		timer_oneshot_max = clocksource_max_idle_ms();
+	}
+
 	writel(timer_reload, CFG_TIMER_VABASE + REG_TIMER_RELOAD);
 	writel(CFG_TIMER_CONTROL, CFG_TIMER_VABASE + REG_TIMER_CONTROL);
 
@@ -91,36 +124,161 @@ int platform_set_periodic_timer(platform_timer_callback callback, void *arg, tim
 	return 0;
 }
 
-static unsigned long gettimeoffset(void)
+/* timer counts from now to the absolute time expires (ms), at least 1 */
+static unsigned long timer_counts_until(bigtime_t expires)
 {
-	unsigned long ticks1, ticks2, status;
+	long long ns;
 
-	ticks2 = readl(CFG_TIMER_VABASE + REG_TIMER_VALUE);
-	do {
-		ticks1 = ticks2;
-		status = readl(ioaddr_intc(REG_INTC_RAWSTATUS));
-		ticks2 = readl(CFG_TIMER_VABASE + REG_TIMER_VALUE);
+	ns = (long long)(expires * NSEC_PER_MSEC - current_time_ns());
+	if (ns <= 0) {
+		return 1;
+	}
 
-	} while ((ticks2 > ticks1) || (ticks2 == 0));
+	return (unsigned long)(((unsigned long long)ns * timer_cycles_per_ms) / NSEC_PER_MSEC);
+}
 
-	ticks1 = timer_reload - ticks2;
-	//printk("ticks1=%d, ticks2=%d, status=0x%x\n", ticks1, ticks2, status);
+static void timer_start(unsigned long load, unsigned long control)
+{
+	timer_load = load;
+	writel(0, CFG_TIMER_VABASE + REG_TIMER_CONTROL);
+	writel(load, CFG_TIMER_VABASE + REG_TIMER_RELOAD);
+	writel(~0, CFG_TIMER_VABASE + REG_TIMER_INTCLR);
+	writel(control, CFG_TIMER_VABASE + REG_TIMER_CONTROL);
+}
 
-	if(status & (1<<CFG_TIMER_INTNR))
-		ticks1 += timer_reload;
+/*
+ * Back to the periodic tick after a one-shot, on the grid of the ticks
+ * before it so that one-shots do not shift the tick phase: a one-shot
+ * up to the next boundary first, unless already on one.
+ */
+static void timer_restart_tick(void)
+{
+	unsigned long long	 tick = NSEC_PER_SEC / HZ;
+	unsigned long long	 now  = current_time_ns();
+	unsigned long long	 next = timer_next_tick_ns();
+	unsigned long long	 left;
 
-	return ticks2ms(ticks1);
+	if ((long long)(next - now) <= TICK_SLOP_NS) {
+		/* on or past that boundary, aim for the one after */
+		if ((long long)(now - next) >= 0) {
+			next += (now - next) / tick * tick;
+		}
+		next += tick;
+	}
+	left = next - now;
+
+	if (left >= tick - TICK_SLOP_NS) {
+		timer_oneshot = 0;
+		timer_phase   = 0;
+		timer_start(timer_reload, CFG_TIMER_CONTROL);
+		return;
+	}
+
+	timer_oneshot = 1;
+	timer_phase   = 1;
+	timer_start((unsigned long)(left * timer_cycles_per_ms / NSEC_PER_MSEC),
+		    CFG_TIMER_CONTROL_ONESHOT);
 }
 
-unsigned long long current_time(void)
+/*
+ * Stop the periodic tick and fire once at the absolute time expires (ms),
+ * clamped to what the 32-bit counter and the clocksource allow. The tick
+ * stays stopped until platform_stop_oneshot_timer() or the one-shot
+ * interrupt.
+ * Returns the number of ms programmed.
+ */
+time_t platform_set_oneshot_timer(bigtime_t expires)
 {
-	return ticks;
+	bigtime_t	 now;
+	time_t		 interval;
+
+	enter_critical_section();
+
+	/* the tick is already due, let it run */
+	if ((timer_oneshot && !timer_phase) || (readl(ioaddr_intc(REG_INTC_RAWSTATUS)) & (1<<CFG_TIMER_INTNR))) {
+		exit_critical_section();
+		return 0;
+	}
+
+	now	 = current_time();
+	interval = (expires > now) ? (time_t)(expires - now) : 1;
+	if (interval > timer_oneshot_max) {
+		interval = timer_oneshot_max;
+		expires	 = now + interval;
+	}
+
+	timer_oneshot = 1;
+	timer_phase   = 0;
+	timer_start(timer_counts_until(expires), CFG_TIMER_CONTROL_ONESHOT);
+
+	exit_critical_section();
+
+	return interval;
+}
+
+/*
+ * Make sure the timer interrupts no later than expires (ms). If the next
+ * interrupt is further away, fire a one-shot at expires instead; the
+ * periodic tick picks up its old phase again after that interrupt.
+ */
+void platform_timer_wakeup_at(bigtime_t expires)
+{
+	unsigned long	 due;
+
+	enter_critical_section();
+
+	/* an interrupt is already pending */
+	if (readl(ioaddr_intc(REG_INTC_RAWSTATUS)) & (1<<CFG_TIMER_INTNR)) {
+		exit_critical_section();
+		return;
+	}
+
+	/* the running period ends first */
+	due = timer_counts_until(expires);
+	if (due >= readl(CFG_TIMER_VABASE + REG_TIMER_VALUE)) {
+		exit_critical_section();
+		return;
+	}
+
+	timer_oneshot = 1;
+	timer_phase   = 0;
+	timer_start(due, CFG_TIMER_CONTROL_ONESHOT);
+
+	exit_critical_section();
+}
+
+/*
+ * Go back to the periodic tick. The time spent in one-shot mode is kept
+ * by the clocksource. Returns 1 if the one-shot period had run out.
+ */
+int platform_stop_oneshot_timer(void)
+{
+	unsigned long	 value;
+
+	enter_critical_section();
+
+	if (!timer_oneshot || timer_phase) {
+		exit_critical_section();
+		return 0;
+	}
+
+	value = readl(CFG_TIMER_VABASE + REG_TIMER_VALUE);
+
+	timer_restart_tick();
+
+	exit_critical_section();
+
+	return (0 == value);
 }
 
 static handler_return platform_tick(void *arg)
 {
-	ticks += gettimeoffset();
-	writel(~0, CFG_TIMER_VABASE + REG_TIMER_INTCLR);
+	if (timer_oneshot) {
+		timer_restart_tick();
+	}
+	else {
+		writel(~0, CFG_TIMER_VABASE + REG_TIMER_INTCLR);
+	}
 
 	if (t_callback) {
 		return t_callback(arg, current_time());
@@ -133,4 +291,3 @@ void platform_init_timer(void)
 {
 	register_int_handler(CFG_TIMER_INTNR, &platform_tick, 0);
 }
-
@@ -23,6 +23,10 @@
 #include <arch/arm.h>
 #include <kernel/printk.h>
 #include <kernel/debug.h>
+#ifdef CONFIG_STACK_GUARD
+#include <kernel/task.h>
+#include <arch/mmu.h>
+#endif
 
 extern void halt(void);
 
@@ -92,8 +96,29 @@ void arm_undefined_handler(struct arm_fault_frame *frame)
 	exception_die(frame, -4, "Undefined abort!\n");
 }
 
+#ifdef CONFIG_STACK_GUARD
+static inline uint32_t arm_read_far(void)
+{
+	uint32_t far;
+
+	__asm__ __volatile__ ("mrc p15, 0, %0, c6, c0, 0" : "=r"(far));
+	return far;
+}
+#endif
+
 void arm_data_abort_handler(struct arm_fault_frame *frame)
 {
+	#ifdef CONFIG_STACK_GUARD
+	uint32_t	 far = arm_read_far();
+
+	if (current_task && current_task->stack &&
+	    (far <  (uint32_t)current_task->stack) &&
+	    (far >= (uint32_t)current_task->stack - PAGE_SIZE)) {
+		printk("Stack overflow in task %s (pid %d), fault at 0x%08x\n",
+		       current_task->name, current_task->pid, far);
+	}
+	#endif
+
 	exception_die(frame, -8, "Data abort!\n");
 }
 
@@ -27,6 +27,7 @@
 #include <kernel/types.h>
 #include <kernel/printk.h>
 #include <mm/malloc.h>
+#include <string.h>
 
 #define MB	(1024 * 1024)
 
@@ -110,6 +111,23 @@ static inline void flush_pgd_entry(pgd_t *gpd)
 	dsb();
 }
 
+#define CACHE_LINE_SIZE	32
+
+/* clean a whole page table out of the D-cache, the table walker reads memory */
+static inline void flush_pt(pte_t *pt, uint32_t size)
+{
+	uint8_t	*p;
+
+	for (p = (uint8_t *)pt; p < (uint8_t *)pt + size; p += CACHE_LINE_SIZE) {
+		asm("mcr p15, 0, %0, c7, c10, 1"
+		    :
+		    :"r" (p)
+		    :"cc");
+	}
+
+	dsb();
+}
+
 void arm_mmu_map_section (addr_t vaddr, addr_t paddr, uint32_t flags)
 {
 	uint32_t	 AP  = 0;
@@ -138,11 +156,82 @@ static inline pte_t *pte_offset(pte_t *pt, unsigned long virtual) {
 	return (pt + index);
 }
 
-void arm_mmu_map_page(addr_t vaddr, addr_t paddr, uint32_t flags)
+/*
+ * One coarse page table contain 256 page table entries, one entry
+ * consumed 4 bytes memory, so one coarse totally consumed 4*256=1k
+ * bytes memory. They must be 1k aligned, so carve them out of pages.
+ */
+#define COARSE_PT_SIZE	(PTRS_PER_PTE * sizeof(pte_t))
+
+static pte_t *arm_mmu_alloc_pt(void)
+{
+	static uint8_t	*pool;
+	static int	 left;
+	pte_t		*pt;
+
+	if (0 == left) {
+		pool = kmalloc(PAGE_SIZE);
+		if (NULL == pool) {
+			return NULL;
+		}
+		left = PAGE_SIZE / COARSE_PT_SIZE;
+	}
+
+	pt    = (pte_t *)pool;
+	pool += COARSE_PT_SIZE;
+	left--;
+
+	memset(pt, 0, COARSE_PT_SIZE);
+	return pt;
+}
+
+/* the page table covering vaddr, splitting a section mapping if needed */
+static pte_t *arm_mmu_get_pt(addr_t vaddr)
 {
 	pgd_t		*pgd = pgd_offset(kernel_pgd, vaddr);
-	pgd_t		 pgd_value;
-	pte_t		 *pte, *pt = NULL;
+	pte_t		*pt;
+	uint32_t	 ap;
+	int		 i;
+
+	switch (*pgd & 3) {
+	case TTB_CPTD:
+		return (pte_t *)ALIGN(phys_to_virt((uint32_t)*pgd), 1024);
+	case TTB_SD:
+		pt = arm_mmu_alloc_pt();
+		if (NULL == pt) {
+			return NULL;
+		}
+
+		/* same memory, same permissions, in small pages */
+		ap = (*pgd & TTB_AP) >> 10;
+		ap = (ap << 4) | (ap << 6) | (ap << 8) | (ap << 10);
+		for (i = 0; i < PTRS_PER_PTE; i++) {
+			pt[i] = ((*pgd & SECTION_MASK) + (i << PAGE_SHIFT)) | ap |
+				(*pgd & (TTB_CACHEABLE | TTB_BUFFERABLE)) |
+				TTB_SPGDT_SMALL_PAGE;
+		}
+		break;
+	case 0:
+		pt = arm_mmu_alloc_pt();
+		if (NULL == pt) {
+			return NULL;
+		}
+		break;
+	default:
+		printk("%s %d: fine page tables are not supported\n", __FILE__, __LINE__);
+		return NULL;
+	}
+
+	flush_pt(pt, COARSE_PT_SIZE);
+	*pgd = (virt_to_phys(pt) & ~(COARSE_PT_SIZE - 1)) | TTB_CPTD;
+	flush_pgd_entry(pgd);
+
+	return pt;
+}
+
+void arm_mmu_map_page(addr_t vaddr, addr_t paddr, uint32_t flags)
+{
+	pte_t		 *pte, *pt;
 	uint32_t	 AP;
 	uint32_t	 CB;
 
@@ -153,31 +242,38 @@ void arm_mmu_map_page(addr_t vaddr, addr_t paddr, uint32_t flags)
 	
 	CB = flags & TTB_SPGTD_CACHEABLE;       /* C bit */
 	CB |= flags & TTB_SPGTD_BUFFERABLE;     /* B bit */
-	
-	pgd = (pgd_t *)ALIGN(pgd, 4);
-
-	/* One coarse page table contain 256 page table entries,
-	one entry consumed 4 bytes memory, so one coarse totally
-	consumed 4*256=1k bytes memory. */
-	if (NULL != pgd) {
-		int i;
 
-		/* allock memmory to store page table */
-		pt = ALIGN(kmalloc(PAGE_SIZE), 1024); //4k bytes
-		for (i=0; i < 4; i++) {
-			pgd_value = (virt_to_phys(pt) + i * 256 * sizeof(pte_t)) | TTB_CPTD;
-			pgd[i] = pgd_value;
-
-			flush_pgd_entry(&pgd[i]);
-		}
+	pt = arm_mmu_get_pt(vaddr);
+	if (NULL == pt) {
+		printk("%s %d: no page table for 0x%x\n", __FILE__, __LINE__, vaddr);
+		return;
 	}
 
-	pt	  = (pte_t *)ALIGN(phys_to_virt((uint32_t)*pgd), 1024);
 	pte	  = pte_offset(pt, vaddr);
 	*pte	  = (paddr & PAGE_MASK) | AP | CB | TTB_SPGDT_SMALL_PAGE;
-	//printk("*pgd=0x%x, pt=0x%x, pte=0x%x *pte=0x%x\n", *pgd, pt, pte, *pte);
+	//printk("pt=0x%x, pte=0x%x *pte=0x%x\n", pt, pte, *pte);
 	//printk("paddr=0x%x, vaddr=0x%x\n", paddr, vaddr);
 
+	flush_pgd_entry(pte);
+	arm_invalidate_tlb();
+}
+
+/* make any access to the page at vaddr fault */
+void arm_mmu_unmap_page(addr_t vaddr)
+{
+	pte_t		*pt;
+	pte_t		*pte;
+
+	pt = arm_mmu_get_pt(vaddr);
+	if (NULL == pt) {
+		return;
+	}
+
+	pte  = pte_offset(pt, vaddr);
+	*pte = TTB_SPGTD_INVALID;
+
+	flush_pgd_entry(pte);
+	arm_invalidate_tlb();
 }
 
 void arm_mmu_create_mapping(struct map_desc *md)
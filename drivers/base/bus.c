@@ -47,7 +47,7 @@ int bus_register(struct bus_type *bus)
 		goto bus_drivers_fail;
 	}
 
-	sema_init(&bus->lock, 1);
+	mutex_init(&bus->lock);
 
 bus_drivers_fail:
 	kset_unregister(bus->devices_kset);
@@ -76,12 +76,12 @@ int bus_for_each_dev(struct bus_type *bus, void *data, int (*fn)(struct device *
 	if (!bus)
 		return -1;
 
-	down(&bus->lock);
+	mutex_lock(&bus->lock);
 	list_for_each_entry(kobj, &dev_kset->list, entry) {
 		dev = kobj_to_dev(kobj);
 		fn(dev, data);
 	}
-	up(&bus->lock);
+	mutex_unlock(&bus->lock);
 	
 	return 0;
 }
@@ -96,7 +96,7 @@ struct device *bus_find_device(struct bus_type *bus,
 	if (!bus)
 		return NULL;
 
-	down(&bus->lock);
+	mutex_lock(&bus->lock);
 	list_for_each_entry(kobj, &dev_kset->list, entry) {
 		dev = kobj_to_dev(kobj);
 		if (match(dev, data))
@@ -104,7 +104,7 @@ struct device *bus_find_device(struct bus_type *bus,
 		else
 			dev = NULL;
 	}
-	up(&bus->lock);
+	mutex_unlock(&bus->lock);
 	
 	return dev;
 }
@@ -146,12 +146,12 @@ int bus_for_each_drv(struct bus_type *bus, void *data, int (*fn)(struct device_d
 	if (!bus)
 		return -1;
 
-	down(&bus->lock);
+	mutex_lock(&bus->lock);
 	list_for_each_entry(kobj, &drv_kset->list, entry) {
 		drv = kobj_to_drv(kobj);
 		fn(drv, data);
 	}
-	up(&bus->lock);
+	mutex_unlock(&bus->lock);
 	
 	return 0;
 }
@@ -192,9 +192,9 @@ void bus_probe_device(struct device *dev)
 	if (!bus)
 		return;
 
-	down(&bus->lock);
+	mutex_lock(&bus->lock);
 	bus_for_each_drv(bus, dev, add_dev);
-	up(&bus->lock);
+	mutex_unlock(&bus->lock);
 	
 	return;
 }
@@ -222,10 +222,10 @@ void bus_remove_device(struct device *dev)
 	if (!bus)
 		return;
 
-	down(&bus->lock);
+	mutex_lock(&bus->lock);
 	bus_for_each_drv(bus, dev, remove_dev);
 	kobject_del(&dev->kobj);
-	up(&bus->lock);
+	mutex_unlock(&bus->lock);
 }
 
 static int add_drv(struct device *dev, void *data)
@@ -252,12 +252,12 @@ int bus_add_driver(struct device_driver *drv)
 	if (!bus)
 		return -1;
 
-	down(&bus->lock);
+	mutex_lock(&bus->lock);
 	drv->kobj.kset = bus->drivers_kset;
 	kobject_add(&drv->kobj);
 
 	ret = bus_for_each_dev(bus, drv, add_drv);
-	up(&bus->lock);
+	mutex_unlock(&bus->lock);
 	
 	return ret;
 }
@@ -268,7 +268,7 @@ void bus_remove_driver(struct device_driver *drv)
 	struct device *dev = NULL;
 	int ret = 0;
 
-	down(&bus->lock);
+	mutex_lock(&bus->lock);
 	kobject_del(&drv->kobj);
 	list_for_each_entry(dev, &drv->list_devices, driver_entry) {
 		if (drv->remove)
@@ -279,7 +279,7 @@ void bus_remove_driver(struct device_driver *drv)
 			}
 		}
 	}
-	up(&bus->lock);
+	mutex_unlock(&bus->lock);
 }
 
 int buses_init(void)
@@ -41,9 +41,9 @@ static void kobj_kset_join(struct kobject *kobj)
 	if (!kobj->kset)
 		return;
 
-	down(&kobj->kset->list_lock);
+	mutex_lock(&kobj->kset->list_lock);
 	list_add_tail(&kobj->entry, &kobj->kset->list);
-	up(&kobj->kset->list_lock);
+	mutex_unlock(&kobj->kset->list_lock);
 }
 
 static void kobj_kset_leave(struct kobject *kobj)
@@ -51,9 +51,9 @@ static void kobj_kset_leave(struct kobject *kobj)
 	if (!kobj->kset)
 		return;
 
-	down(&kobj->kset->list_lock);
+	mutex_lock(&kobj->kset->list_lock);
 	list_del_init(&kobj->entry);
-	up(&kobj->kset->list_lock);
+	mutex_unlock(&kobj->kset->list_lock);
 }
 
 int kobject_add(struct kobject *kobj)
@@ -124,7 +124,7 @@ void kset_init(struct kset *k)
 {
 	kobject_init(&k->kobj);
 	INIT_LIST_HEAD(&k->list);
-	sema_init(&k->list_lock, 1);
+	mutex_init(&k->list_lock);
 }
 
 int kset_register(struct kset *k)
@@ -155,7 +155,7 @@ struct kobject *kset_find_obj(struct kset *kset, const char *name)
 	struct kobject *k;
 	struct kobject *ret = NULL;
 
-	down(&kset->list_lock);
+	mutex_lock(&kset->list_lock);
 
 	list_for_each_entry(k, &kset->list, entry) {
 		if (kobject_name(k) && !strcmp(kobject_name(k), name)) {
@@ -164,7 +164,7 @@ struct kobject *kset_find_obj(struct kset *kset, const char *name)
 		}
 	}
 
-	up(&kset->list_lock);
+	mutex_unlock(&kset->list_lock);
 	return ret;
 }
 
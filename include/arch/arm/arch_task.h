@@ -24,7 +24,11 @@
 #ifndef _ARCH_TASK_H_
 #define _ARCH_TASK_H_
 
+extern int arch_force_switch_mm;
+
 void arch_task_initialize(task_t *t);
 void arch_context_switch(task_t *oldtask, task_t *newtask);
+void arch_task_guard_stack(void *guard);
+void arch_task_unguard_stack(void *guard);
 
 #endif
@@ -32,6 +32,7 @@
 typedef enum handler_return {
 	INT_NO_RESCHEDULE = 0,
 	INT_RESCHEDULE,
+	INT_WAKE_THREAD,	/* top half of a threaded irq, see request_threaded_irq() */
 }handler_return;
 
 int mask_interrupt(unsigned int vector);
@@ -39,9 +39,13 @@
 //#define CFG_TIMER_VABASE	(uint32_t)phys_to_virt(REG_BASE_TIMER_01)
 #define CFG_TIMER_VABASE	REG_BASE_TIMER_01
 #define CFG_TIMER_CONTROL	( (1<<7) | (1<<6) | (1<<5) | (1<<1) )
+#define CFG_TIMER_CONTROL_ONESHOT	( (1<<7) | (1<<5) | (1<<1) | (1<<0) )
 #define CFG_TIMER_PRESCALE	1
 #define BUSCLK_TO_TIMER_RELOAD(busclk)	(((busclk)/CFG_TIMER_PRESCALE)/HZ)
 #define CFG_TIMER_INTNR		INTNR_TIMER_0
+/* the other timer of the pair, free-running 32-bit without interrupts */
+#define CFG_CLOCK_VABASE	(REG_BASE_TIMER_01 + REG_TIMER_135_OFFSET)
+#define CFG_CLOCK_CONTROL	( (1<<7) | (1<<1) )
 
 #define ticks2us(ticks) (((ticks)*((1000000/HZ) >> 2))/(timer_reload >> 2))
 #define ticks2ms(ticks) (((ticks)*((1000/HZ) >> 2))/(timer_reload >> 2))
@@ -53,6 +57,8 @@ typedef handler_return (*platform_timer_callback)(void *arg, time_t now);
 
 void platform_init_timer(void);
 int platform_set_periodic_timer(platform_timer_callback callback, void *arg, time_t interval);
-unsigned long long current_time(void);
+time_t platform_set_oneshot_timer(bigtime_t expires);
+int platform_stop_oneshot_timer(void);
+void platform_timer_wakeup_at(bigtime_t expires);
 
 #endif
@@ -48,11 +48,14 @@ typedef uint32_t	pgd_t;
 
 #define pgd_index(addr)         ((addr) >> PGDIR_SHIFT)
 #define pgd_offset(pgd, addr)   ((pgd_t *)(((pgd_t *)(pgd) ) + pgd_index(addr)))
+#define PTRS_PER_PTE		256
 #define pte_index(addr)         (((addr) >> PAGE_SHIFT) & (PTRS_PER_PTE - 1))
 
 #define ALIGN(P, ALIGNBYTES)    ((void*)((uint32_t)(P) & (~((ALIGNBYTES)-1))))
 
 void	arm_mmu_init(void);
+void	arm_mmu_map_page(addr_t vaddr, addr_t paddr, uint32_t flags);
+void	arm_mmu_unmap_page(addr_t vaddr);
 void	arm_mmu_remap_evt(void);
 void	clean_user_space(void);
 #endif
@@ -38,6 +38,7 @@
 #define __maybe_unused		__attribute__((unused))
 #define __always_unused		__attribute__((unused))
 #define __always_inline		inline __attribute__((always_inline))
+#define barrier()		__asm__ __volatile__("" : : : "memory")
 
 #else
 
@@ -53,6 +54,7 @@
 #define __maybe_unused
 #define __always_unused
 #define __always_inline
+#define barrier()
 
 #endif
 #endif
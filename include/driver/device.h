@@ -50,7 +50,7 @@ struct bus_type {
 	struct kobject		 kobj;
 	struct kset		*devices_kset;
 	struct kset		*drivers_kset;
-	struct semaphore	 lock;
+	struct mutex		 lock;
 
 	int (*match)(struct device *dev, struct device_driver *drv);
 	int (*probe)(struct device *dev);
@@ -24,7 +24,7 @@
 #ifndef __KOBJECT_H__
 #define __KOBJECT_H__
 
-#include <kernel/semaphore.h>
+#include <kernel/mutex.h>
 
 struct kset;
 
@@ -37,7 +37,7 @@ struct kobject {
 
 struct kset {
 	struct list_head	list;
-	struct semaphore	list_lock;
+	struct mutex		list_lock;
 	struct kobject		kobj;
 };
 
@@ -27,6 +27,11 @@
 #include <kernel/list.h>
 
 #define CONSOLE_BUFFER_SIZE 256
+#define SHELL_PRIORITY      160
+
+/* tasks the benchmark and self-test commands start, see init/cmd_*.c */
+#define BENCH_STACK_SIZE	(0x400)
+#define BENCH_LOOPS		1000
 
 #define CMD_FUNC(name)					\
 	static int do_command_##name(char *args)
@@ -45,8 +50,57 @@ struct shell_command {
 	int (*func)(char *args);
 };
 
+/*
+ * A behaviour check for the selftest command. func returns 0 if the
+ * kernel did what it should, SELFTEST_SKIP if the check cannot run in
+ * the current configuration, anything else if it failed.
+ */
+#define SELFTEST_SKIP	1
+
+struct selftest {
+	const char *name;
+	int (*func)(void);
+};
+
+struct selftest_set {
+	struct list_head list;
+	const char *name;
+	const struct selftest *tests;
+	int nr_tests;
+};
+
+#define SELFTEST_SET(name, set_name, tests)			\
+	static struct selftest_set name = { {NULL, NULL},	\
+					    set_name,		\
+					    tests,		\
+					    sizeof(tests) / sizeof((tests)[0]) }
+
+struct task;
+
 void shell_unregister_command(struct shell_command *cmd);
 void shell_register_command(struct shell_command *cmd);
 int init_shell(void *arg);
+unsigned long simple_strtoul(const char *cp, char **endp, unsigned int base);
+char *shell_next_arg(char *args);
+void shell_copy_arg(char *buf, int size, const char *args);
+void register_sched_commands(void);
+void register_rr_commands(void);
+void register_edf_commands(void);
+void register_mutex_commands(void);
+void register_switch_commands(void);
+void register_wakeup_commands(void);
+void register_trace_commands(void);
+void register_cyclic_commands(void);
+void register_periodic_commands(void);
+void register_tgroup_commands(void);
+void register_task_commands(void);
+void register_timer_commands(void);
+void register_irq_commands(void);
+void register_ipc_commands(void);
+void register_pt_commands(void);
+void register_selftest_commands(void);
+void selftest_register(struct selftest_set *set);
+struct task *selftest_task(char *name, unsigned int priority,
+			   int (*entry)(void *), void *arg);
 
 #endif
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __KERNEL_CLOCKSOURCE_H__
+#define __KERNEL_CLOCKSOURCE_H__
+
+/*
+ * A free-running hardware counter, extended to the 64-bit monotonic
+ * clocks behind current_time_ns(), current_time_hires() and
+ * current_time(). The counter may be narrower than 32 bits, it only
+ * has to be folded in by clocksource_update() before it wraps, which
+ * the tick does; tickless idle must not last longer than
+ * clocksource_max_idle_ms().
+ */
+struct clocksource {
+	const char		*name;
+	unsigned long		(*read)(void);	/* counts up */
+	unsigned long		 mask;		/* of the counter's width */
+	unsigned long		 freq;		/* Hz */
+
+	/* set by clocksource_register(): ns = (cycles * mult) >> shift */
+	unsigned long		 mult;
+	unsigned int		 shift;
+	unsigned long		 max_idle_ms;
+};
+
+#define NSEC_PER_SEC	1000000000UL
+#define NSEC_PER_MSEC	1000000UL
+#define NSEC_PER_USEC	1000UL
+
+void clocksource_register(struct clocksource *cs);
+void clocksource_update(void);
+unsigned long clocksource_max_idle_ms(void);
+unsigned long long current_time_ns(void);
+
+#endif
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _IPC_H_
+#define _IPC_H_
+
+#include <kernel/list.h>
+#include <kernel/task.h>
+
+/* a message is a few registers worth, copied by value */
+#define IPC_MSG_WORDS	4
+
+struct ipc_msg {
+	unsigned long	w[IPC_MSG_WORDS];
+};
+
+/* one server task receives the calls made on an endpoint, a second is refused */
+struct ipc_endpoint {
+	task_t			*server;	/* waiting in ipc_reply_wait() */
+	struct list_head	 callers;	/* calls the server has not taken yet */
+};
+
+#define __IPC_ENDPOINT_INITIALIZER(name)			\
+{								\
+	.server		= NULL,					\
+	.callers	= LIST_HEAD_INIT((name).callers),	\
+}
+
+#define DEFINE_IPC_ENDPOINT(name)	\
+	struct ipc_endpoint name = __IPC_ENDPOINT_INITIALIZER(name)
+
+static inline void ipc_endpoint_init(struct ipc_endpoint *ep)
+{
+	*ep = (struct ipc_endpoint) __IPC_ENDPOINT_INITIALIZER(*ep);
+}
+
+void ipc_call(struct ipc_endpoint *ep, struct ipc_msg *msg);
+task_t *ipc_reply_wait(struct ipc_endpoint *ep, task_t *caller, struct ipc_msg *msg);
+void ipc_reply(task_t *caller, struct ipc_msg *msg);
+
+#endif /* _IPC_H_ */
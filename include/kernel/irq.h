@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __KERNEL_IRQ_H__
+#define __KERNEL_IRQ_H__
+
+#include <kernel/list.h>
+#include <kernel/task.h>
+#include <kernel/semaphore.h>
+#include <arch/interrupts.h>
+
+/* softirqs, run in this order on interrupt exit */
+enum {
+	TIMER_SOFTIRQ,
+	TASKLET_SOFTIRQ,
+	NR_SOFTIRQS
+};
+
+typedef handler_return (*softirq_action)(void);
+
+struct tasklet_struct {
+	struct tasklet_struct	*next;
+	unsigned long		 state;
+	void			(*func)(unsigned long);
+	unsigned long		 data;
+};
+
+#define TASKLET_STATE_SCHED	0x01
+
+#define DECLARE_TASKLET(name, _func, _data) \
+	struct tasklet_struct name = { NULL, 0, (_func), (_data) }
+
+/* a handler installed with request_threaded_irq() */
+struct irq_action {
+	struct list_head	 list;
+	unsigned int		 vector;
+	int_handler		 handler;	/* top half, interrupts masked */
+	int_handler		 thread_fn;	/* runs in the irq task */
+	void			*arg;
+	int			 oneshot;	/* vector masked until thread_fn is done */
+	struct semaphore	 wakeup;
+	task_t			*task;
+	unsigned long		 count;
+	unsigned long		 thread_count;
+};
+
+struct irq_stats {
+	unsigned long		hardirqs;
+	unsigned long		hardirq_max;	/* us with interrupts masked */
+	unsigned long		softirqs[NR_SOFTIRQS];
+	unsigned long		softirq_max;	/* us, interrupts enabled */
+};
+
+extern struct irq_stats		irq_stats;
+extern struct list_head		irq_actions;
+
+static inline void tasklet_init(struct tasklet_struct *t,
+				void (*func)(unsigned long), unsigned long data)
+{
+	t->next	 = NULL;
+	t->state = 0;
+	t->func	 = func;
+	t->data	 = data;
+}
+
+int request_threaded_irq(unsigned int vector, int_handler handler,
+			 int_handler thread_fn, void *arg,
+			 unsigned int priority, char *name);
+
+void open_softirq(int nr, softirq_action action);
+void raise_softirq(int nr);
+void do_softirq(void);
+int in_interrupt(void);
+void tasklet_schedule(struct tasklet_struct *t);
+void softirq_init(void);
+
+void irq_enter(void);
+void irq_exit(handler_return ret);
+
+#endif
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _MUTEX_H_
+#define _MUTEX_H_
+
+#include <kernel/list.h>
+
+struct task;
+
+/*
+ * A sleeping lock with a single owner. Waiters are queued by priority
+ * and the owner inherits the priority of its highest waiter, through
+ * any chain of mutexes the owner itself is blocked on.
+ */
+struct mutex {
+	int			 locked;
+	struct task		*owner;
+	struct list_head	 wait_list;
+	/* entry in the owner's held_mutexes */
+	struct list_head	 held;
+};
+
+#define __MUTEX_INITIALIZER(name)				\
+{								\
+	.locked		= 0,					\
+	.owner		= NULL,					\
+	.wait_list	= LIST_HEAD_INIT((name).wait_list),	\
+	.held		= LIST_HEAD_INIT((name).held),		\
+}
+
+#define DEFINE_MUTEX(name)	\
+	struct mutex name = __MUTEX_INITIALIZER(name)
+
+static inline void mutex_init(struct mutex *lock)
+{
+	*lock = (struct mutex) __MUTEX_INITIALIZER(*lock);
+}
+
+static inline int mutex_is_locked(struct mutex *lock)
+{
+	return lock->locked;
+}
+
+extern void mutex_lock(struct mutex *lock);
+extern int mutex_trylock(struct mutex *lock);
+extern void mutex_unlock(struct mutex *lock);
+
+#endif /* _MUTEX_H_ */
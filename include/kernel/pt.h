@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _PT_H_
+#define _PT_H_
+
+#include <kernel/list.h>
+#include <kernel/semaphore.h>
+#include <kernel/wait_queue.h>
+#include <kernel/completion.h>
+
+/*
+ * Protothreads: stackless cooperative tasks, all run by one kernel task,
+ * see kernel/pt.c. A protothread is a function that is called again
+ * each time it can make progress and picks up after the PT_ statement
+ * it stopped at. Locals do not survive a wait, keep state in the
+ * structure the struct pt is embedded in. Switch statements cannot be
+ * used around PT_ statements.
+ */
+struct pt;
+
+typedef int (*pt_func)(struct pt *pt);
+
+/* what a protothread function returns */
+#define PT_WAITING	0	/* woken by pt_wake() */
+#define PT_YIELDED	1	/* run again after the others */
+#define PT_EXITED	2
+#define PT_ENDED	3
+
+struct pt {
+	struct list_head	 list;	/* ready or sleeping */
+	pt_func			 func;
+	unsigned short		 lc;	/* line to resume at */
+	unsigned long		 wake;	/* PT_SLEEP() deadline, current_time() */
+	union {
+		struct semaphore_waiter	 sem;
+		wait_queue_t		 wait;
+	} u;
+};
+
+#define PT_BEGIN(pt)		switch ((pt)->lc) { case 0:
+
+#define PT_END(pt)		} (pt)->lc = 0; return PT_ENDED
+
+/* give up the cpu until pt_wake() */
+#define PT_WAIT_EVENT(pt)					\
+	do {							\
+		(pt)->lc = __LINE__; return PT_WAITING;		\
+		case __LINE__:;					\
+	} while (0)
+
+#define PT_YIELD(pt)						\
+	do {							\
+		(pt)->lc = __LINE__; return PT_YIELDED;		\
+		case __LINE__:;					\
+	} while (0)
+
+/* polls cond each time the other protothreads had their turn */
+#define PT_WAIT_UNTIL(pt, cond)					\
+	do {							\
+		(pt)->lc = __LINE__;				\
+		case __LINE__:					\
+		if (!(cond)) return PT_YIELDED;			\
+	} while (0)
+
+#define PT_EXIT(pt)						\
+	do {							\
+		(pt)->lc = 0; return PT_EXITED;			\
+	} while (0)
+
+#define PT_SLEEP(pt, ms)					\
+	do {							\
+		pt_sleep((pt), (ms));				\
+		PT_WAIT_EVENT(pt);				\
+	} while (0)
+
+#define PT_SEM_DOWN(pt, sem)					\
+	do {							\
+		if (pt_sem_down((pt), (sem)))			\
+			PT_WAIT_EVENT(pt);			\
+	} while (0)
+
+#define PT_WAIT_FOR_COMPLETION(pt, x)				\
+	do {							\
+		while (pt_wait_for_completion((pt), (x)))	\
+			PT_WAIT_EVENT(pt);			\
+	} while (0)
+
+struct pt_stats {
+	unsigned long	 started;
+	unsigned long	 live;
+	unsigned long	 runs;
+};
+
+extern struct pt_stats pt_stats;
+
+void pt_start(struct pt *pt, pt_func func);
+void pt_wake(struct pt *pt);
+void pt_sleep(struct pt *pt, unsigned long ms);
+int pt_sem_down(struct pt *pt, struct semaphore *sem);
+int pt_wait_for_completion(struct pt *pt, struct completion *x);
+void pt_init(void);
+
+#endif /* _PT_H_ */
@@ -25,15 +25,132 @@
 #define _SCHED_H_
 #include <kernel/task.h>
 
+/* enqueue_task() flags */
+#define ENQUEUE_WAKEUP	0x01
+
 struct sched_class {
 	const struct sched_class *next;
 	void (*init) ();
 	void (*enqueue_task) (task_t *p, int flags);
 	void (*dequeue_task) (task_t *p, int flags);
 	task_t * (*pick_next_task) ();
+	int (*task_tick) (task_t *p);
 	void (*dump) ();
 };
 
+extern const struct sched_class *scheduler;
+extern const struct sched_class  sched_class_cyclic;
+extern const struct sched_class  sched_class_edf;
+extern const struct sched_class  sched_class_fifo;
+
 void sched_init();
+int sched_tick(void);
+void sched_enqueue_task(task_t *p, int flags);
+void sched_dequeue_task(task_t *p, int flags);
+task_t *sched_pick_next_task(void);
+void sched_check_preempt(task_t *p);
+void sched_dump(void);
+void sched_set_class(task_t *p, const struct sched_class *class);
+void sched_set_priority(task_t *p, unsigned int priority);
+
+/* priority used to order waiters, frame and deadline tasks go first */
+static inline unsigned int task_wait_priority(task_t *p)
+{
+	if ((p->sched_class == &sched_class_cyclic) || (p->sched_class == &sched_class_edf)) {
+		return HIGHEST_PRIORITY;
+	}
+
+	return p->priority;
+}
+
+int task_set_deadline(task_t *task, unsigned long deadline, unsigned long period);
+void task_wait_period(void);
+
+/* cyclic executive, see kernel/sched_cyclic.c */
+#define CYCLIC_MAX_JOBS	16
+#define CYCLIC_IDLE	0xff	/* a minor frame nobody owns */
+
+struct cyclic_table {
+	unsigned int		 minor_ticks;	/* length of a minor frame */
+	unsigned int		 nr_frames;	/* minor frames per major frame */
+	const unsigned char	*frames;	/* job owning each minor frame */
+};
+
+/* DEFINE_CYCLIC_TABLE(control, 2, 0, 1, 0, CYCLIC_IDLE) */
+#define DEFINE_CYCLIC_TABLE(name, minor, ...)				\
+	static const unsigned char name##_frames[] = { __VA_ARGS__ };	\
+	const struct cyclic_table name = {				\
+		.minor_ticks = (minor),					\
+		.nr_frames   = sizeof(name##_frames),			\
+		.frames	     = name##_frames,				\
+	}
+
+struct cyclic_stats {
+	unsigned long	major_frames;
+	unsigned long	idle_frames;
+	unsigned long	overruns;
+	unsigned long	jitter_max;	/* us from frame start to dispatch */
+};
+
+extern struct cyclic_stats cyclic_stats;
+
+int sched_cyclic_tick(void);
+int cyclic_start(const struct cyclic_table *table);
+void cyclic_stop(void);
+int cyclic_running(void);
+const struct cyclic_table *cyclic_get_table(void);
+unsigned int cyclic_get_frame(void);
+int cyclic_job_stats(unsigned int job, task_t **task, unsigned long *frames,
+		     unsigned long *overruns);
+int task_set_cyclic(task_t *task, unsigned int job);
+void task_wait_frame(void);
+
+/* cpu reservations for groups of fifo tasks, see kernel/task_group.c */
+#define TASK_GROUP_MAX		8
+
+#define TG_ARMED		0x01	/* budget in use, replenish_at is set */
+#define TG_THROTTLED		0x02	/* budget used up, tasks are parked */
+
+struct task_group {
+	char			 name[16];	/* empty for a free slot */
+	unsigned long		 budget;	/* us of cpu per period */
+	unsigned long		 period;	/* us */
+	long			 remaining;
+	unsigned int		 flags;
+	unsigned long long	 replenish_at;
+	struct list_head	 throttled;	/* runnable tasks parked by the fifo class */
+	timer_t			 timer;
+	int			 nr_tasks;
+
+	/* accounting */
+	unsigned long long	 runtime;
+	unsigned long		 nr_throttled;
+	unsigned long long	 throttled_time;
+	unsigned long long	 throttled_since;
+};
+
+extern struct task_group task_groups[TASK_GROUP_MAX];
+
+static inline int task_group_throttled(task_t *p)
+{
+	return (NULL != p->group) && (p->group->flags & TG_THROTTLED);
+}
+
+struct task_group *task_group_create(const char *name, unsigned long budget,
+				     unsigned long period);
+struct task_group *task_group_find(const char *name);
+int task_group_set(struct task_group *group, unsigned long budget, unsigned long period);
+int task_group_destroy(struct task_group *group);
+int task_group_attach(task_t *task, struct task_group *group);
+void task_group_charge(task_t *task, unsigned long long now, unsigned long delta);
+void task_group_park(task_t *task);
+
+#ifdef CONFIG_SCHED_RR
+extern int sched_rr_enabled;
+
+int sched_rr_set_slice(unsigned int priority, unsigned int ticks);
+unsigned int sched_rr_get_slice(unsigned int priority);
+int task_set_time_slice(task_t *task, unsigned int ticks);
+#endif
 
 #endif
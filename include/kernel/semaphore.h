@@ -30,6 +30,17 @@ struct semaphore {
 	struct list_head	wait_list;
 };
 
+struct task;
+struct pt;
+
+/* a task blocked in down(), or a protothread in PT_SEM_DOWN() */
+struct semaphore_waiter {
+	struct list_head	 list;
+	struct task		*task;
+	struct pt		*pt;
+	int			 up;
+};
+
 #define __SEMAPHORE_INITIALIZER(name, n)			\
 {                                                               \
 	.count		= n,                                    \
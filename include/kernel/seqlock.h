@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __KERNEL_SEQLOCK_H__
+#define __KERNEL_SEQLOCK_H__
+
+#include <compiler.h>
+
+/*
+ * Sequence counter: readers retry instead of locking. The count is odd
+ * while a write is in progress. Writers must not be interrupted by a
+ * reader, so they run in interrupt context or in a critical section;
+ * readers may run anywhere, including in interrupt handlers.
+ */
+typedef struct seqcount {
+	volatile unsigned int	sequence;
+} seqcount_t;
+
+#define SEQCNT_ZERO	{ 0 }
+
+static __always_inline void seqcount_init(seqcount_t *s)
+{
+	s->sequence = 0;
+}
+
+static __always_inline unsigned int read_seqcount_begin(const seqcount_t *s)
+{
+	unsigned int ret;
+
+	do {
+		ret = s->sequence;
+	} while (unlikely(ret & 1));
+	barrier();
+
+	return ret;
+}
+
+static __always_inline int read_seqcount_retry(const seqcount_t *s, unsigned int start)
+{
+	barrier();
+
+	return unlikely(s->sequence != start);
+}
+
+static __always_inline void write_seqcount_begin(seqcount_t *s)
+{
+	s->sequence++;
+	barrier();
+}
+
+static __always_inline void write_seqcount_end(seqcount_t *s)
+{
+	barrier();
+	s->sequence++;
+}
+
+#endif
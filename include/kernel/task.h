@@ -26,9 +26,30 @@
 
 #include <kernel/list.h>
 #include <kernel/mm.h>
+#include <kernel/timer.h>
+#include <kernel/trace.h>
 #include <compiler.h>
 
-#define MAX_PRIORITY	 8
+#define MAX_PRIORITY	 256
+#define HIGHEST_PRIORITY 0
+/* reserved for the init task, which idles the cpu */
+#define IDLE_PRIORITY	 (MAX_PRIORITY - 1)
+
+/* task_t flags */
+#define TASK_DETACHED	0x01	/* freed by the reaper when it exits */
+#define TASK_STATIC	0x02	/* TASK_DEFINE() storage, never freed */
+
+/* task_create_periodic() tasks get PERIODIC_PRIO_BASE and up, by period */
+#define PERIODIC_PRIO_BASE	8
+#define PERIODIC_MAX_TASKS	32
+
+/* pids are handed out from a bitmap, 0 .. PID_MAX - 1 */
+#define PID_MAX		1024
+
+#define REAPER_PRIORITY	64
+
+/* fill pattern of unused stack, see task_stack_used() */
+#define STACK_MAGIC	0x57ac57ac
 
 #define LONG_MAX	((long)(~0UL>>1))
 #define	MAX_SCHEDULE_TIMEOUT	LONG_MAX
@@ -53,13 +74,59 @@ enum task_state {                // Task state values
 
 typedef int (*task_routine)(void *arg);
 
+struct sched_class;
+struct task_group;
+struct ipc_msg;
+struct mutex;
+struct mutex_waiter;
+
+/* task_create_periodic() state, times in milliseconds */
+struct periodic_state {
+	struct list_head	list;		/* periodic_list, by period */
+	task_routine		entry;		/* called once per release */
+	unsigned long		period;		/* 0 for other tasks */
+	unsigned long		wcet;
+	unsigned long		release;	/* absolute, current_time() */
+	unsigned long		jobs;
+	unsigned long		overruns;	/* jobs that ran longer than wcet */
+	unsigned long		missed;		/* releases lost to late jobs */
+};
+
 typedef struct task {
 	struct list_head list;
 	unsigned int sp;
 	
+	/* effective priority, raised above base_priority by inheritance */
 	unsigned int priority;
+	unsigned int base_priority;
 	enum task_state state;
 
+	const struct sched_class *sched_class;
+
+	/* round-robin slice in ticks, 0 means the priority's default */
+	unsigned int time_slice;
+	unsigned int time_left;
+
+	/* earliest-deadline-first job parameters, in ms of current_time() */
+	unsigned long deadline;
+	unsigned long period;
+	unsigned long release;
+	unsigned long abs_deadline;
+	unsigned int  deadline_misses;
+	unsigned int  edf_flags;
+
+	/* cyclic executive job this task is bound to */
+	unsigned int cyclic_job;
+
+	struct periodic_state periodic;
+
+	/* cpu reservation shared with the other tasks of the group */
+	struct task_group *group;
+
+	/* ipc_call() message waiting for its reply, or receive buffer */
+	struct ipc_msg *ipc_msg;
+	struct task *ipc_partner;
+
 	void *stack;
 	int stack_size;
 
@@ -71,22 +138,100 @@ typedef struct task {
 	void *args;
 
 	int ret;
+	unsigned int flags;
+	/* task blocked in task_join() on this one */
+	struct task *joiner;
+
+	/* task_sleep() and schedule_timeout() sleep on this */
+	timer_t sleep_timer;
 
 	char name[32];
+
+	struct list_head task_list;
+
+	/* cpu accounting, times in microseconds from current_time_hires() */
+	unsigned long long start_time;
+	unsigned long long last_run;
+	unsigned long long runtime;
+	unsigned long long wakeup_time;
+	unsigned long long trace_wakeup;	/* ns, for the wakeup tracer */
+	unsigned long wakeup_latency;
+	unsigned long wakeup_latency_max;
+	unsigned long nvcsw;
+	unsigned long nivcsw;
+
+	/* priority inheritance state, see kernel/mutex.c */
+	struct list_head held_mutexes;
+	struct mutex *blocked_on;
+	struct mutex_waiter *mutex_waiter;
 } task_t;
 
-extern int	 critical_section_count;
-extern task_t	*current_task;
+/*
+ * A task whose control block and stack are reserved at link time,
+ * started by task_init() without touching the heap:
+ *
+ *	TASK_DEFINE(reaper, REAPER_PRIORITY, 0x400, task_reaper);
+ *
+ * entry is called with a NULL argument. The control block and stack go
+ * to .bss.tasks, the descriptor to .task_static, see build.ld. The stack
+ * gets no guard page with CONFIG_STACK_GUARD.
+ */
+struct task_static {
+	task_t			*task;
+	unsigned int		*stack;
+	unsigned int		 stack_size;
+	unsigned int		 priority;
+	task_routine		 entry;
+	const char		*name;
+};
+
+#define TASK_DEFINE(_name, _prio, _stack_size, _entry)				\
+	static task_t __task_##_name						\
+		__attribute__((section(".bss.tasks")));				\
+	static unsigned int __task_stack_##_name[(_stack_size) / sizeof(unsigned int)] \
+		__attribute__((section(".bss.tasks"))) __aligned(8);		\
+	static const struct task_static __task_static_##_name			\
+		__attribute__((used, section(".task_static"))) = {		\
+		.task		= &__task_##_name,				\
+		.stack		= __task_stack_##_name,				\
+		.stack_size	= (_stack_size),				\
+		.priority	= (_prio),					\
+		.entry		= (_entry),					\
+		.name		= #_name,					\
+	}
+
+extern int		 critical_section_count;
+extern int		 need_resched;
+extern task_t		*current_task;
+extern struct list_head	 task_list;
 
 void initial_task_func(void);
 task_t *task_alloc(char *name, int stack_size, unsigned int priority);
 void task_free(task_t *task);
 int task_create(task_t *task, task_routine entry, void *args);
 void task_schedule(void);
+void task_switch_to(task_t *next);
+void preempt_schedule(void);
 void task_sleep(unsigned long delay);
-void task_create_init(void);
+void task_sleep_slack(unsigned long delay, unsigned long slack);
+void task_sleep_ms_until(unsigned long expires);
+void task_sleep_until(unsigned long long deadline);
+void task_usleep(unsigned long usecs);
 void task_init(void);
 void task_exit(int retcode);
+task_t *task_find_by_pid(int pid);
+task_t *task_create_periodic(char *name, unsigned long period, unsigned long wcet,
+			     task_routine entry, void *args);
+void task_periodic_exit(task_t *task);
+void periodic_utilization(unsigned long *util, unsigned long *bound);
+int task_join(task_t *task, int *retcode);
+int task_detach(task_t *task);
+unsigned long task_stack_used(task_t *task);
+void task_account_switch(task_t *prev, task_t *next);
+void task_account_tick(task_t *task);
+
+/* what task_account_switch() may add to a context switch, checked by acctbench */
+#define TASK_ACCT_BUDGET_NS	2000
 
 void arch_enable_ints(void);
 void arch_disable_ints(void);
@@ -100,10 +245,26 @@ static __always_inline void enter_critical_section(void)
 		arch_disable_ints();
 	}
 	critical_section_count++;
+	if (critical_section_count == 1)
+	{
+		trace_critical_enter();
+	}
 }
 
+/*
+ * Wakeups only set need_resched, the switch happens once when the
+ * outermost critical section is left (or on interrupt return).
+ */
 static __always_inline void exit_critical_section(void)
 {
+	if (1 == critical_section_count)
+	{
+		if (need_resched)
+		{
+			preempt_schedule();
+		}
+		trace_critical_exit();
+	}
 	critical_section_count--;
 	if (critical_section_count == 0)
 	{
@@ -26,6 +26,7 @@
 #include <compiler.h>
 #include <kernel/list.h>
 #include <kernel/types.h>
+#include <kernel/clocksource.h>
 #include <arch/interrupts.h>
 
 struct timer;
@@ -35,10 +36,23 @@ typedef volatile struct timer {
 	struct list_head	entry;
 	unsigned long		expired_time;
 	unsigned long		periodic_time;
+	/* ms the expiry may be moved later by to share a wakeup, see timer_set_slack() */
+	unsigned long		slack;
+	unsigned long		requested;	/* expiry before the slack */
+	unsigned int		flags;		/* TIMER_SOFT, TIMER_SOFT_QUEUED */
+	unsigned int		soft_slot;	/* in the timer task's ring while queued */
 	timer_function		function;
 	void *arg;
 }timer_t;
 
+/*
+ * A hard timer's function runs in the timer softirq, with interrupts
+ * enabled but nothing else able to run, and must not block. A soft
+ * timer's runs in the timer task and may, see timer_set_soft().
+ */
+#define TIMER_SOFT		0x01
+#define TIMER_SOFT_QUEUED	0x02	/* due, waiting for the timer task */
+
 #define TIMER_INITIALIZER(_function, _expires, _periodic,  _data) {	\
 		.function      = (_function),	\
 		.expired_time  = (_expires),	\
@@ -50,15 +64,80 @@ static __always_inline void init_timer_value(timer_t *t)
 {
 	t->expired_time = 0;
 	t->periodic_time = 0;
+	t->slack = 0;
+	t->requested = 0;
+	t->flags = 0;
 	t->function = NULL;
 	t->arg = NULL;
 	INIT_LIST_HEAD((struct list_head *)&t->entry);
 }
 
+/* timing wheel counters, see timerbench */
+struct timer_stats {
+	unsigned long		added;
+	unsigned long		deleted;	/* while still pending */
+	unsigned long		expired;
+	unsigned long		cascaded;	/* moves down a level of the wheel */
+	unsigned long		overruns;	/* periods a periodic timer skipped */
+	unsigned long		passes;		/* softirq runs that expired timers */
+	unsigned long		slack_moved;	/* expiries moved within their slack */
+	unsigned long		wakeups_saved;	/* ms wanted less ms run, per pass */
+	unsigned long		soft_queued;	/* handed to the timer task */
+	unsigned long		soft_run;	/* functions the timer task ran */
+	unsigned long		soft_deferred;	/* put off a ms, the task's ring was full */
+	unsigned long long	softirq_time;	/* us spent running the wheel and callbacks */
+};
+
+/*
+ * Let the timer expire up to slack ms late, from its next add on, so it
+ * can be served by the same wakeup as others. It stays until changed.
+ */
+static __always_inline void timer_set_slack(timer_t *t, unsigned long slack)
+{
+	t->slack = slack;
+}
+
+/*
+ * Have the timer's function run in the timer task rather than in the
+ * softirq, from its next expiry on, so that it can sleep or take locks.
+ * Hard is the default.
+ */
+static __always_inline void timer_set_soft(timer_t *t, int soft)
+{
+	if (soft)
+	{
+		t->flags |= TIMER_SOFT;
+	}
+	else
+	{
+		t->flags &= ~TIMER_SOFT;
+	}
+}
+
+/* what the idle loop has been up to, times in microseconds */
+struct idle_stats {
+	unsigned long long	residency;
+	unsigned long		wakeups;
+	unsigned long		tickless;	/* idle periods with the tick stopped */
+	unsigned long		timer_wakeups;	/* of those, ended by the one-shot timer */
+};
+
+extern struct timer_stats timer_stats;
+extern struct idle_stats idle_stats;
+#ifdef CONFIG_TICKLESS
+extern int tickless_enabled;
+#endif
+
+/* an interrupt this close before a tick boundary still counts as the tick */
+#define TICK_SLOP_NS		(100 * NSEC_PER_USEC)
+
 unsigned long long current_time(void);
+unsigned long long current_time_hires(void);
 void oneshot_timer_add(timer_t *timer, unsigned long delay, timer_function function, void *arg);
 void periodic_timer_add(timer_t *timer, unsigned long period, timer_function function, void *arg);
 void timer_delete(timer_t *timer);
+unsigned long long timer_next_tick_ns(void);
 void timer_init(void);
+void timer_idle(void);
 
 #endif
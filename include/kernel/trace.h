@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __KERNEL_TRACE_H__
+#define __KERNEL_TRACE_H__
+
+/*
+ * Wakeup latency tracer: the time from a task becoming ready to the
+ * scheduler picking it, for fifo tasks at or above a priority. The
+ * events leading up to the worst case seen are kept for the shell.
+ * Every hook is called with interrupts disabled.
+ */
+
+struct task;
+
+enum {
+	TRACE_WAKEUP,		/* arg: pid of the task woken */
+	TRACE_SWITCH,		/* arg: pid of the task picked */
+	TRACE_IRQ_ENTER,
+	TRACE_IRQ_EXIT,		/* arg: what the handlers returned */
+	TRACE_CS_ENTER,		/* arg: pc entering the outermost critical section */
+	TRACE_CS_EXIT,		/* arg: pc leaving it */
+	NR_TRACE_TYPES
+};
+
+struct trace_event {
+	unsigned long long	time;	/* current_time_ns() */
+	unsigned short		type;
+	unsigned short		pid;	/* current task */
+	unsigned long		arg;
+};
+
+/* events kept in the ring and in the worst case snapshot */
+#define TRACE_EVENTS			128
+
+/* tasks at this priority or above (numerically lower) are traced */
+#define WAKEUP_TRACE_DEFAULT_PRIO	128
+
+struct wakeup_trace {
+	unsigned long		latency;	/* nanoseconds */
+	int			pid;
+	unsigned int		priority;
+	char			name[32];
+	int			nr_events;
+	struct trace_event	events[TRACE_EVENTS];
+};
+
+#ifdef CONFIG_WAKEUP_TRACE
+extern int			wakeup_trace_enabled;
+extern unsigned int		wakeup_trace_prio;
+extern struct wakeup_trace	wakeup_trace_max;
+
+void trace_event(int type, unsigned long arg);
+void wakeup_trace_wakeup(struct task *p);
+void wakeup_trace_pick(struct task *p);
+void wakeup_trace_reset(void);
+
+/* address of the caller's code, works inside inline functions */
+#define _THIS_IP_	({ __label__ __here; __here: (unsigned long)&&__here; })
+
+/* a load and a branch on every critical section while the tracer is off */
+#define trace_critical_enter()						\
+	do {								\
+		if (wakeup_trace_enabled)				\
+			trace_event(TRACE_CS_ENTER, _THIS_IP_);		\
+	} while (0)
+#define trace_critical_exit()						\
+	do {								\
+		if (wakeup_trace_enabled)				\
+			trace_event(TRACE_CS_EXIT, _THIS_IP_);		\
+	} while (0)
+#else
+#define trace_event(type, arg)		do { } while (0)
+#define wakeup_trace_wakeup(p)		do { } while (0)
+#define wakeup_trace_pick(p)		do { } while (0)
+#define trace_critical_enter()		do { } while (0)
+#define trace_critical_exit()		do { } while (0)
+#endif
+
+#endif
@@ -25,7 +25,7 @@
 #define _WAIT_QUEUE_H_
 
 #include <kernel/list.h>
-#include <kernel/semaphore.h>
+#include <kernel/mutex.h>
 
 typedef struct __wait_queue wait_queue_t;
 typedef int (*wait_queue_func_t)(wait_queue_t *wait);
@@ -40,7 +40,7 @@ struct __wait_queue {
 };
 
 struct __wait_queue_head {
-	struct semaphore	lock;
+	struct mutex		lock;
 	struct list_head	task_list;
 };
 typedef struct __wait_queue_head wait_queue_head_t;
@@ -56,7 +56,7 @@ struct task_struct;
 	wait_queue_t name = __WAITQUEUE_INITIALIZER(name, tsk)
 
 #define __WAIT_QUEUE_HEAD_INITIALIZER(name) {				\
-	.lock		= __SPIN_LOCK_UNLOCKED(name.lock),		\
+	.lock		= __MUTEX_INITIALIZER(name.lock),		\
 	.task_list	= { &(name).task_list, &(name).task_list } }
 
 #define DECLARE_WAIT_QUEUE_HEAD(name) \
@@ -5,6 +5,7 @@
 #include <kernel/timer.h>
 
 #define WQ_STACK_SIZE		(0x2000)
+#define WQ_PRIORITY		32
 
 struct workqueue_struct;
 
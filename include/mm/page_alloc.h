@@ -25,7 +25,7 @@
 #define __PAGE_ALLOC_H__
 
 #include <kernel/types.h>
-#include <kernel/semaphore.h>
+#include <kernel/mutex.h>
 
 #define MIN_ORDER	0
 #define MAX_ORDER	11
@@ -66,7 +66,7 @@ struct zone {
 	unsigned long		spanned_pages;
 	unsigned long		managed_pages;
 	struct free_area	free_area[MAX_ORDER];
-	struct semaphore	lock;
+	struct mutex		lock;
 	const char		*name;
 };
 
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include <kernel/types.h>
+#include <kernel/printk.h>
+#include <kernel/task.h>
+#include <kernel/sched.h>
+#include <kernel/timer.h>
+#include <init.h>
+#include <arch/timer.h>
+
+/*
+ * cyclic          frame table state, overruns and dispatch jitter
+ * cyclic stop     stop the table, its tasks stop running
+ */
+CMD_FUNC(cyclic) {
+	const struct cyclic_table	*table = cyclic_get_table();
+	task_t				*task;
+	unsigned long			 frames;
+	unsigned long			 overruns;
+	unsigned int			 job;
+
+	if (args && (0 == strncmp(args, "stop", 4))) {
+		cyclic_stop();
+		return 0;
+	}
+
+	if (NULL == table) {
+		printk("no frame table running\n");
+		return 0;
+	}
+
+	printk("minor frame:   %d ticks, %d per major frame\n",
+	       table->minor_ticks, table->nr_frames);
+	printk("current frame: %d\n", cyclic_get_frame());
+	printk("major frames:  %d\n", (int)cyclic_stats.major_frames);
+	printk("idle frames:   %d\n", (int)cyclic_stats.idle_frames);
+	printk("overruns:      %d\n", (int)cyclic_stats.overruns);
+	printk("jitter max:    %d us\n", (int)cyclic_stats.jitter_max);
+
+	printk("job  pid name               frames overruns\n");
+	for (job = 0; job < CYCLIC_MAX_JOBS; job++) {
+		if (cyclic_job_stats(job, &task, &frames, &overruns)) {
+			continue;
+		}
+		printk("%3d %4d %-16s %8d %8d\n", job, task->pid, task->name,
+		       (int)frames, (int)overruns);
+	}
+
+	return 0;
+}
+
+#define CYCLICTEST_FRAMES	10
+#define CYCLICTEST_TICK_NS	(NSEC_PER_SEC / HZ)
+
+/* job 0 owns every other one tick frame */
+DEFINE_CYCLIC_TABLE(cyclictest_table, 1, 0, CYCLIC_IDLE);
+
+static unsigned long long cyclictest_start[CYCLICTEST_FRAMES];
+
+static int cyclictest_job(void *arg)
+{
+	int i;
+
+	for (i = 0; i < CYCLICTEST_FRAMES; i++) {
+		cyclictest_start[i] = current_time_ns();
+		task_wait_frame();
+	}
+
+	return 0;
+}
+
+/*
+ * A job that is done well within its frames is released every two
+ * ticks, give or take half a tick, and never overruns.
+ */
+static int selftest_cyclic(void)
+{
+	unsigned long long	 period = 2 * CYCLICTEST_TICK_NS;
+	unsigned long long	 gap, gap_min = ~0ULL, gap_max = 0;
+	task_t			*task;
+	int			 bound;
+	int			 i;
+
+	if (cyclic_running()) {
+		printk("a frame table is running already\n");
+		return SELFTEST_SKIP;
+	}
+
+	memset(cyclictest_start, 0, sizeof(cyclictest_start));
+	task = selftest_task("cyclic", current_task->priority + 1, cyclictest_job, NULL);
+	if (NULL == task) {
+		return -1;
+	}
+
+	/* if it is not bound, it does not wait for frames and finishes at once */
+	bound = (0 == task_set_cyclic(task, 0));
+	if (bound) {
+		cyclic_start(&cyclictest_table);
+	}
+	task_join(task, NULL);
+	cyclic_stop();
+
+	for (i = 1; i < CYCLICTEST_FRAMES; i++) {
+		gap = cyclictest_start[i] - cyclictest_start[i - 1];
+		if (gap < gap_min) {
+			gap_min = gap;
+		}
+		if (gap > gap_max) {
+			gap_max = gap;
+		}
+	}
+
+	if (!bound || cyclic_stats.overruns ||
+	    (gap_min < period - CYCLICTEST_TICK_NS / 2) ||
+	    (gap_max > period + CYCLICTEST_TICK_NS / 2)) {
+		printk("%s, %d overruns, releases %d to %d us apart\n",
+		       bound ? "bound to job 0" : "job 0 taken", (int)cyclic_stats.overruns,
+		       (int)(gap_min / NSEC_PER_USEC), (int)(gap_max / NSEC_PER_USEC));
+		return -1;
+	}
+
+	return 0;
+}
+
+static const struct selftest cyclic_tests[] = {
+	{ "cyclic",	selftest_cyclic },
+};
+
+SELFTEST_SET(cyclic_selftests, "sched", cyclic_tests);
+
+SHELL_COMMAND(cyclic_command, "cyclic", "help: cyclic [stop], frame table state, overruns and dispatch jitter", CMD_FUNC_NAME(cyclic));
+
+void register_cyclic_commands(void)
+{
+	shell_register_command(&cyclic_command);
+	selftest_register(&cyclic_selftests);
+}
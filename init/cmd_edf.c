@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include <kernel/types.h>
+#include <kernel/printk.h>
+#include <kernel/task.h>
+#include <kernel/sched.h>
+#include <init.h>
+
+CMD_FUNC(edf) {
+	task_t *task;
+
+	printk(" pid name             deadline   period   misses\n");
+	list_for_each_entry(task, &task_list, task_list) {
+		if (task->sched_class != &sched_class_edf) {
+			continue;
+		}
+		printk("%4d %-16s %8d %8d %8d\n", task->pid, task->name,
+		       (int)task->deadline, (int)task->period,
+		       task->deadline_misses);
+	}
+
+	return 0;
+}
+
+static struct {
+	int	order[2];
+	int	nr;
+} edftest;
+
+static int edftest_task(void *arg)
+{
+	edftest.order[edftest.nr++] = (int)(unsigned long)arg;
+	return 0;
+}
+
+/*
+ * Two deadline tasks released together: the one with the earlier
+ * deadline runs first, although it was made a deadline task last.
+ */
+static int selftest_edf(void)
+{
+	static const unsigned long	 deadlines[2] = { 200, 50 };
+	task_t				*tasks[2];
+	int				 created;
+	int				 i;
+
+	memset(&edftest, 0, sizeof(edftest));
+	for (created = 0; created < 2; created++) {
+		tasks[created] = selftest_task("edf", current_task->priority + 1, edftest_task,
+					       (void *)(unsigned long)created);
+		if (NULL == tasks[created]) {
+			break;
+		}
+	}
+
+	enter_critical_section();
+	for (i = 0; i < created; i++) {
+		task_set_deadline(tasks[i], deadlines[i], 0);
+	}
+	need_resched = 1;
+	exit_critical_section();
+
+	for (i = 0; i < created; i++) {
+		task_join(tasks[i], NULL);
+	}
+
+	if ((2 != created) || (2 != edftest.nr) || (1 != edftest.order[0])) {
+		printk("%d of 2 ran, the %d ms deadline first\n", edftest.nr,
+		       edftest.nr ? (int)deadlines[edftest.order[0]] : 0);
+		return -1;
+	}
+
+	return 0;
+}
+
+static const struct selftest edf_tests[] = {
+	{ "edf",	selftest_edf },
+};
+
+SELFTEST_SET(edf_selftests, "sched", edf_tests);
+
+SHELL_COMMAND(edf_command, "edf", "help: list deadline tasks and their deadline misses", CMD_FUNC_NAME(edf));
+
+void register_edf_commands(void)
+{
+	shell_register_command(&edf_command);
+	selftest_register(&edf_selftests);
+}
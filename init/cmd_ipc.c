@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include <kernel/types.h>
+#include <kernel/printk.h>
+#include <kernel/task.h>
+#include <kernel/timer.h>
+#include <kernel/semaphore.h>
+#include <kernel/ipc.h>
+#include <init.h>
+
+#define IPC_ROUNDS	1000
+#define IPC_QUIT	(~0UL)
+
+struct sembench {
+	struct semaphore	req;
+	struct semaphore	resp;
+	unsigned long		buf;
+};
+
+static int ipc_echo_server(void *arg)
+{
+	struct ipc_endpoint	*ep	= arg;
+	task_t			*caller = NULL;
+	struct ipc_msg		 msg;
+
+	for (;;) {
+		caller = ipc_reply_wait(ep, caller, &msg);
+		if (IPC_QUIT == msg.w[0]) {
+			ipc_reply(caller, &msg);
+			return 0;
+		}
+		msg.w[0]++;
+	}
+}
+
+static int sem_echo_server(void *arg)
+{
+	struct sembench *sb = arg;
+
+	for (;;) {
+		down(&sb->req);
+		if (IPC_QUIT == sb->buf) {
+			up(&sb->resp);
+			return 0;
+		}
+		sb->buf++;
+		up(&sb->resp);
+	}
+}
+
+static task_t *ipcbench_server(task_routine entry, void *arg)
+{
+	task_t		*server;
+	unsigned int	 prio = current_task->priority;
+
+	if (prio > 0) {
+		prio--;
+	}
+
+	server = task_alloc("echo", BENCH_STACK_SIZE, prio);
+	if ((NULL != server) && task_create(server, entry, arg)) {
+		task_free(server);
+		server = NULL;
+	}
+
+	return server;
+}
+
+/*
+ * Round trips to a higher priority echo server, through ipc_call() and
+ * through a request/response semaphore pair around a shared word.
+ */
+CMD_FUNC(ipcbench) {
+	struct ipc_endpoint	 ep;
+	struct sembench		 sb;
+	struct ipc_msg		 msg;
+	task_t			*server;
+	unsigned long long	 start;
+	long			 ipc, sem;
+	int			 i;
+
+	ipc_endpoint_init(&ep);
+	server = ipcbench_server(ipc_echo_server, &ep);
+	if (NULL == server) {
+		printk("ipcbench: could not create tasks\n");
+		return -1;
+	}
+
+	msg.w[0] = 0;
+	start	 = current_time_ns();
+	for (i = 0; i < IPC_ROUNDS; i++) {
+		ipc_call(&ep, &msg);
+	}
+	ipc = (long)((current_time_ns() - start) / IPC_ROUNDS);
+
+	msg.w[0] = IPC_QUIT;
+	ipc_call(&ep, &msg);
+	task_join(server, NULL);
+
+	sema_init(&sb.req, 0);
+	sema_init(&sb.resp, 0);
+	sb.buf = 0;
+	server = ipcbench_server(sem_echo_server, &sb);
+	if (NULL == server) {
+		printk("ipcbench: could not create tasks\n");
+		return -1;
+	}
+
+	start = current_time_ns();
+	for (i = 0; i < IPC_ROUNDS; i++) {
+		up(&sb.req);
+		down(&sb.resp);
+	}
+	sem = (long)((current_time_ns() - start) / IPC_ROUNDS);
+
+	sb.buf = IPC_QUIT;
+	up(&sb.req);
+	down(&sb.resp);
+	task_join(server, NULL);
+
+	printk("round trip, ipc_call:   %d ns\n", (int)ipc);
+	printk("round trip, semaphores: %d ns\n", (int)sem);
+
+	return 0;
+}
+
+#define CALLTEST_WORD	41
+
+static int ipc_second_server(void *arg)
+{
+	struct ipc_endpoint	*ep = arg;
+	struct ipc_msg		 msg;
+	task_t			*caller;
+
+	caller = ipc_reply_wait(ep, NULL, &msg);
+	if (NULL == caller) {
+		return 0;
+	}
+
+	/* it took the endpoint over and got a call */
+	ipc_reply(caller, &msg);
+	return -1;
+}
+
+/*
+ * ipc_call() gets the echo server's answer back, and a second server
+ * on the same endpoint is turned away instead of taking it over.
+ */
+static int selftest_call(void)
+{
+	struct ipc_endpoint	 ep;
+	struct ipc_msg		 msg;
+	task_t			*server;
+	task_t			*second;
+	unsigned long		 echoed;
+	int			 refused = -1;
+
+	ipc_endpoint_init(&ep);
+	server = ipcbench_server(ipc_echo_server, &ep);
+	if (NULL == server) {
+		return -1;
+	}
+
+	msg.w[0] = CALLTEST_WORD;
+	ipc_call(&ep, &msg);
+	echoed = msg.w[0];
+
+	second = selftest_task("ipc2", current_task->priority - 1, ipc_second_server, &ep);
+	if (NULL != second) {
+		enter_critical_section();
+		task_schedule();
+		exit_critical_section();
+
+		if (EXITED != second->state) {
+			/* it is waiting on the endpoint, call it and give ep back */
+			ipc_call(&ep, &msg);
+			ep.server = server;
+		}
+		task_join(second, &refused);
+	}
+
+	msg.w[0] = IPC_QUIT;
+	ipc_call(&ep, &msg);
+	task_join(server, NULL);
+
+	if ((CALLTEST_WORD + 1 != echoed) || (0 != refused)) {
+		printk("echoed %d for %d, second server %s\n", (int)echoed, CALLTEST_WORD,
+		       refused ? "not refused" : "refused");
+		return -1;
+	}
+
+	return 0;
+}
+
+static const struct selftest ipc_tests[] = {
+	{ "call",	selftest_call },
+};
+
+SELFTEST_SET(ipc_selftests, "ipc", ipc_tests);
+
+SHELL_COMMAND(ipcbench_command, "ipcbench", "help: echo server round trip, ipc_call against semaphores", CMD_FUNC_NAME(ipcbench));
+
+void register_ipc_commands(void)
+{
+	shell_register_command(&ipcbench_command);
+	selftest_register(&ipc_selftests);
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include <kernel/types.h>
+#include <kernel/printk.h>
+#include <kernel/task.h>
+#include <kernel/timer.h>
+#include <kernel/irq.h>
+#include <arch/timer.h>
+#include <init.h>
+
+/*
+ * irqstat          time spent with interrupts masked in handlers, softirq
+ *                  counts and threaded handlers
+ * irqstat reset    clear the maxima and counts
+ */
+CMD_FUNC(irqstat) {
+	static const char	*softirq_names[NR_SOFTIRQS] = { "timer", "tasklet" };
+	struct irq_action	*action;
+	int			 i;
+
+	if (args && (0 == strncmp(args, "reset", 5))) {
+		enter_critical_section();
+		memset(&irq_stats, 0, sizeof(irq_stats));
+		exit_critical_section();
+		return 0;
+	}
+
+	printk("hardirqs:      %d, longest %d us\n",
+	       (int)irq_stats.hardirqs, (int)irq_stats.hardirq_max);
+	printk("softirq max:   %d us\n", (int)irq_stats.softirq_max);
+	for (i = 0; i < NR_SOFTIRQS; i++) {
+		printk("  %-10s %d\n", softirq_names[i], (int)irq_stats.softirqs[i]);
+	}
+
+	printk("vector task             prio   irqs thread runs\n");
+	list_for_each_entry(action, &irq_actions, list) {
+		printk("%6d %-16s %4d %6d %11d\n", action->vector,
+		       action->task->name, action->task->priority,
+		       (int)action->count, (int)action->thread_count);
+	}
+
+	return 0;
+}
+
+static struct tasklet_struct	 tasklettest;
+static volatile int		 tasklettest_runs;
+static volatile int		 tasklettest_in_interrupt;
+
+static void tasklettest_function(unsigned long data)
+{
+	tasklettest_runs++;
+	tasklettest_in_interrupt = in_interrupt();
+}
+
+/*
+ * A tasklet scheduled twice before it got to run runs once, from the
+ * softirq. Scheduled by a task outside any critical section it runs
+ * before tasklet_schedule() returns.
+ */
+static int selftest_tasklet(void)
+{
+	int batched, direct;
+
+	tasklet_init(&tasklettest, tasklettest_function, 0);
+	tasklettest_runs	 = 0;
+	tasklettest_in_interrupt = 0;
+
+	enter_critical_section();
+	tasklet_schedule(&tasklettest);
+	tasklet_schedule(&tasklettest);
+	exit_critical_section();
+
+	/* the next interrupt runs it */
+	task_sleep(2 * 1000 / HZ);
+	batched = tasklettest_runs;
+
+	tasklet_schedule(&tasklettest);
+	direct = tasklettest_runs - batched;
+
+	if ((1 != batched) || (1 != direct) || !tasklettest_in_interrupt) {
+		printk("runs: %d scheduled twice, %d scheduled directly, %s\n",
+		       batched, direct,
+		       tasklettest_in_interrupt ? "in softirq" : "not in softirq");
+		return -1;
+	}
+
+	return 0;
+}
+
+static const struct selftest irq_tests[] = {
+	{ "tasklet",	selftest_tasklet },
+};
+
+SELFTEST_SET(irq_selftests, "irq", irq_tests);
+
+SHELL_COMMAND(irqstat_command, "irqstat", "help: irqstat [reset], interrupt, softirq and irq thread statistics", CMD_FUNC_NAME(irqstat));
+
+void register_irq_commands(void)
+{
+	shell_register_command(&irqstat_command);
+	selftest_register(&irq_selftests);
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include <kernel/types.h>
+#include <kernel/printk.h>
+#include <kernel/task.h>
+#include <kernel/mutex.h>
+#include <init.h>
+
+static DEFINE_MUTEX(pitest_lock);
+
+static struct {
+	unsigned int	order[2];
+	int		nr;
+} pitest;
+
+static int pitest_waiter(void *arg)
+{
+	mutex_lock(&pitest_lock);
+	pitest.order[pitest.nr++] = current_task->priority;
+	mutex_unlock(&pitest_lock);
+
+	return 0;
+}
+
+/* start a waiter above us and let it block on pitest_lock */
+static task_t *pitest_block(unsigned int priority)
+{
+	task_t *task;
+
+	task = selftest_task("pi", priority, pitest_waiter, NULL);
+	if (NULL != task) {
+		enter_critical_section();
+		task_schedule();
+		exit_critical_section();
+	}
+
+	return task;
+}
+
+/*
+ * We hold a mutex two higher priority tasks block on, the lower one
+ * first. We run at the higher one's priority until we unlock, then at
+ * our own again, and the higher one gets the mutex first.
+ */
+static int selftest_pi(void)
+{
+	unsigned int	 base = current_task->priority;
+	unsigned int	 boosted, after;
+	task_t		*low, *high;
+
+	memset(&pitest, 0, sizeof(pitest));
+
+	mutex_lock(&pitest_lock);
+	low	= pitest_block(base - 10);
+	high	= pitest_block(base - 20);
+	boosted = current_task->priority;
+	mutex_unlock(&pitest_lock);
+	after	= current_task->priority;
+
+	if (NULL != low) {
+		task_join(low, NULL);
+	}
+	if (NULL != high) {
+		task_join(high, NULL);
+	}
+
+	if ((NULL == low) || (NULL == high) || (boosted != base - 20) || (after != base) ||
+	    (2 != pitest.nr) || (pitest.order[0] != base - 20)) {
+		printk("priority %d, %d holding the mutex, %d after; ", base, boosted, after);
+		printk("%d of 2 waiters got it, priority %d first\n", pitest.nr,
+		       pitest.nr ? pitest.order[0] : 0);
+		return -1;
+	}
+
+	return 0;
+}
+
+static const struct selftest mutex_tests[] = {
+	{ "pi",		selftest_pi },
+};
+
+SELFTEST_SET(mutex_selftests, "sched", mutex_tests);
+
+void register_mutex_commands(void)
+{
+	selftest_register(&mutex_selftests);
+}
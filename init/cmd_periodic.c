@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include <kernel/types.h>
+#include <kernel/printk.h>
+#include <kernel/task.h>
+#include <kernel/sched.h>
+#include <init.h>
+
+CMD_FUNC(periodic) {
+	task_t		*task;
+	unsigned long	 util, bound;
+
+	periodic_utilization(&util, &bound);
+	printk("utilization: %d.%d%% of %d.%d%% (rate-monotonic bound)\n",
+	       (int)(util / 10000), (int)(util / 1000 % 10),
+	       (int)(bound / 10000), (int)(bound / 1000 % 10));
+
+	printk(" pid name             prio   period     wcet     jobs overruns   missed\n");
+	list_for_each_entry(task, &task_list, task_list) {
+		if (0 == task->periodic.period) {
+			continue;
+		}
+		printk("%4d %-16s %4d %8d %8d %8d %8d %8d\n", task->pid, task->name,
+		       task->priority, (int)task->periodic.period,
+		       (int)task->periodic.wcet, (int)task->periodic.jobs,
+		       (int)task->periodic.overruns, (int)task->periodic.missed);
+	}
+
+	return 0;
+}
+
+#define RMTEST_PERIOD	100	/* ms */
+
+static volatile int rmtest_stop;
+
+static int rmtest_job(void *arg)
+{
+	return rmtest_stop;
+}
+
+/*
+ * Rate-monotonic admission, the bound for two tasks is 82.8%: 50% and
+ * 40% do not fit under it, 50% and 30% do.
+ */
+static int selftest_rm(void)
+{
+	task_t		*first, *over, *fits;
+	unsigned long	 util, bound;
+
+	periodic_utilization(&util, &bound);
+	if (util) {
+		printk("periodic tasks are running already\n");
+		return SELFTEST_SKIP;
+	}
+
+	rmtest_stop = 0;
+	first = task_create_periodic("rm50", RMTEST_PERIOD, RMTEST_PERIOD * 5 / 10, rmtest_job, NULL);
+	over  = task_create_periodic("rm40", RMTEST_PERIOD, RMTEST_PERIOD * 4 / 10, rmtest_job, NULL);
+	fits  = task_create_periodic("rm30", RMTEST_PERIOD, RMTEST_PERIOD * 3 / 10, rmtest_job, NULL);
+
+	/* they are detached, they stop at their next release and are reaped */
+	rmtest_stop = 1;
+	task_sleep(2 * RMTEST_PERIOD);
+	periodic_utilization(&util, &bound);
+
+	if ((NULL == first) || (NULL != over) || (NULL == fits) || util) {
+		printk("50%% %s, 40%% on top %s, 30%% on top %s, %d ppm left after\n",
+		       first ? "admitted" : "refused", over ? "admitted" : "refused",
+		       fits ? "admitted" : "refused", (int)util);
+		return -1;
+	}
+
+	return 0;
+}
+
+static const struct selftest periodic_tests[] = {
+	{ "rm",		selftest_rm },
+};
+
+SELFTEST_SET(periodic_selftests, "sched", periodic_tests);
+
+SHELL_COMMAND(periodic_command, "periodic", "help: periodic tasks, utilization, overruns and missed releases", CMD_FUNC_NAME(periodic));
+
+void register_periodic_commands(void)
+{
+	shell_register_command(&periodic_command);
+	selftest_register(&periodic_selftests);
+}
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include <kernel/types.h>
+#include <kernel/printk.h>
+#include <kernel/task.h>
+#include <kernel/timer.h>
+#include <kernel/semaphore.h>
+#include <kernel/pt.h>
+#include <kernel/completion.h>
+#include <init.h>
+#include <mm/malloc.h>
+
+#define PTBENCH_SLEEPS	10
+
+struct ptbench {
+	struct semaphore	 go;
+	struct completion	 done;
+	int			 left;
+};
+
+struct ptbench_pt {
+	struct pt		 pt;
+	struct ptbench		*bench;
+	int			 sleeps;
+};
+
+static int ptbench_thread(struct pt *pt)
+{
+	struct ptbench_pt *p = container_of(pt, struct ptbench_pt, pt);
+
+	PT_BEGIN(pt);
+
+	PT_SEM_DOWN(pt, &p->bench->go);
+
+	for (p->sleeps = 0; p->sleeps < PTBENCH_SLEEPS; p->sleeps++) {
+		PT_SLEEP(pt, 1);
+	}
+
+	if (0 == --p->bench->left) {
+		complete(&p->bench->done);
+	}
+
+	PT_END(pt);
+}
+
+/*
+ * ptbench <n>: n protothreads block on a semaphore, then sleep 1ms ten
+ * times each; shows what they cost next to a task and its stack.
+ */
+CMD_FUNC(ptbench) {
+	struct ptbench		 bench;
+	struct ptbench_pt	*pts;
+	unsigned long long	 start;
+	int			 n = 100;
+	int			 i;
+
+	if (args && *args) {
+		n = simple_strtoul(args, NULL, 10);
+	}
+	if (n <= 0) {
+		return -1;
+	}
+
+	pts = kmalloc(n * sizeof(*pts));
+	if (NULL == pts) {
+		printk("ptbench: no memory for %d protothreads\n", n);
+		return -1;
+	}
+
+	sema_init(&bench.go, 0);
+	init_completion(&bench.done);
+	bench.left = n;
+
+	for (i = 0; i < n; i++) {
+		pts[i].bench = &bench;
+		pt_start(&pts[i].pt, ptbench_thread);
+	}
+
+	start = current_time_hires();
+	for (i = 0; i < n; i++) {
+		up(&bench.go);
+	}
+	wait_for_completion(&bench.done);
+
+	printk("%d protothreads, %d sleeps each: %d ms\n", n, PTBENCH_SLEEPS,
+	       (int)((current_time_hires() - start) / 1000));
+	printk("%d bytes per protothread, %d live, %d runs\n", (int)sizeof(*pts),
+	       (int)pt_stats.live, (int)pt_stats.runs);
+
+	kfree(pts);
+
+	return 0;
+}
+
+#define PTTEST_SLEEP	5	/* ms */
+
+struct pttest {
+	struct pt		 pt;
+	struct semaphore	 go;
+	int			 got_sem;
+	unsigned long		 woken;		/* current_time() past the semaphore */
+	unsigned long		 slept;		/* and past the sleep */
+	int			 done;
+};
+
+static int pttest_thread(struct pt *pt)
+{
+	struct pttest *p = container_of(pt, struct pttest, pt);
+
+	PT_BEGIN(pt);
+
+	PT_SEM_DOWN(pt, &p->go);
+	p->got_sem = 1;
+	p->woken   = (unsigned long)current_time();
+
+	PT_SLEEP(pt, PTTEST_SLEEP);
+	p->slept = (unsigned long)current_time();
+	p->done	 = 1;
+
+	PT_END(pt);
+}
+
+/*
+ * A protothread waits on a semaphore until it is upped, then sleeps
+ * for at least PTTEST_SLEEP ms. Static, it may outlive a failed check.
+ */
+static int selftest_pt(void)
+{
+	static struct pttest	 p;
+	int			 early;
+
+	memset(&p, 0, sizeof(p));
+	sema_init(&p.go, 0);
+	pt_start(&p.pt, pttest_thread);
+
+	task_sleep(PTTEST_SLEEP);
+	early = p.got_sem;
+
+	up(&p.go);
+	task_sleep(PTTEST_SLEEP * 4);
+
+	if (early || !p.done || ((signed long)(p.slept - p.woken) < PTTEST_SLEEP)) {
+		printk("%s, %s, slept %d ms\n",
+		       early ? "went past the semaphore early" : "waited on the semaphore",
+		       p.done ? "done" : "not done", (int)(p.slept - p.woken));
+		return -1;
+	}
+
+	return 0;
+}
+
+static const struct selftest pt_tests[] = {
+	{ "pt",		selftest_pt },
+};
+
+SELFTEST_SET(pt_selftests, "ipc", pt_tests);
+
+SHELL_COMMAND(ptbench_command, "ptbench", "help: ptbench [n], n protothreads on a semaphore and 1ms sleeps, time and footprint", CMD_FUNC_NAME(ptbench));
+
+void register_pt_commands(void)
+{
+	shell_register_command(&ptbench_command);
+	selftest_register(&pt_selftests);
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include <kernel/types.h>
+#include <kernel/printk.h>
+#include <kernel/task.h>
+#include <kernel/sched.h>
+#include <init.h>
+
+#ifdef CONFIG_SCHED_RR
+/*
+ * timeslice                      show round-robin state
+ * timeslice on|off               enable or disable time slicing
+ * timeslice prio <prio> <ticks>  set the default slice of a priority
+ * timeslice task <pid> <ticks>   set the slice of one task, 0 for default
+ */
+CMD_FUNC(timeslice) {
+	task_t		*task;
+	unsigned long	 id;
+	unsigned long	 ticks;
+	char		*arg;
+
+	if ((NULL == args) || ('\0' == *args)) {
+		printk("round-robin: %s\n", sched_rr_enabled ? "on" : "off");
+		list_for_each_entry(task, &task_list, task_list) {
+			printk("%4d %-16s prio %3d slice %d\n",
+			       task->pid, task->name, task->priority,
+			       task->time_slice ? task->time_slice :
+			       sched_rr_get_slice(task->priority));
+		}
+		return 0;
+	}
+
+	if (0 == strncmp(args, "on", 2)) {
+		sched_rr_enabled = 1;
+		return 0;
+	}
+
+	if (0 == strncmp(args, "off", 3)) {
+		sched_rr_enabled = 0;
+		return 0;
+	}
+
+	arg   = shell_next_arg(args);
+	id    = simple_strtoul(arg, NULL, 10);
+	arg   = shell_next_arg(arg);
+	ticks = simple_strtoul(arg, NULL, 10);
+
+	if (0 == strncmp(args, "prio", 4)) {
+		if (sched_rr_set_slice(id, ticks)) {
+			printk("invalid priority or slice\n");
+			return -1;
+		}
+		return 0;
+	}
+
+	if (0 == strncmp(args, "task", 4)) {
+		task = task_find_by_pid(id);
+		if (NULL == task) {
+			printk("no task with pid %d\n", (int)id);
+			return -1;
+		}
+		return task_set_time_slice(task, ticks);
+	}
+
+	printk("usage: timeslice [on|off|prio <prio> <ticks>|task <pid> <ticks>]\n");
+	return -1;
+}
+
+SHELL_COMMAND(timeslice_command, "timeslice", "help: show or set round-robin time slices", CMD_FUNC_NAME(timeslice));
+
+#define RRTEST_SPIN_MS	100
+#define RRTEST_TURNS	3
+
+static struct {
+	volatile int	last;		/* which of the two ran last */
+	int		turns[2];	/* times each took over from the other */
+} rrtest;
+
+static int rrtest_spin(void *arg)
+{
+	int			 me  = (int)(unsigned long)arg;
+	unsigned long long	 end = current_time_hires() + RRTEST_SPIN_MS * 1000;
+
+	while (current_time_hires() < end) {
+		if (rrtest.last != me) {
+			rrtest.last = me;
+			rrtest.turns[me]++;
+		}
+	}
+
+	return 0;
+}
+#endif
+
+/*
+ * Two tasks spinning at the same priority with one tick slices take
+ * turns; first come, first served the first would spin to the end.
+ */
+static int selftest_rr(void)
+{
+	#ifdef CONFIG_SCHED_RR
+	task_t	*tasks[2];
+	int	 created;
+	int	 i;
+
+	if (!sched_rr_enabled) {
+		return SELFTEST_SKIP;
+	}
+
+	memset(&rrtest, 0, sizeof(rrtest));
+	rrtest.last = -1;
+	for (created = 0; created < 2; created++) {
+		tasks[created] = selftest_task("rr", current_task->priority - 1, rrtest_spin,
+					       (void *)(unsigned long)created);
+		if (NULL == tasks[created]) {
+			break;
+		}
+		task_set_time_slice(tasks[created], 1);
+	}
+
+	for (i = 0; i < created; i++) {
+		task_join(tasks[i], NULL);
+	}
+
+	if ((2 != created) || (rrtest.turns[0] < RRTEST_TURNS) || (rrtest.turns[1] < RRTEST_TURNS)) {
+		printk("turns in %d ms: %d and %d\n", RRTEST_SPIN_MS,
+		       rrtest.turns[0], rrtest.turns[1]);
+		return -1;
+	}
+
+	return 0;
+	#else
+	return SELFTEST_SKIP;
+	#endif
+}
+
+static const struct selftest rr_tests[] = {
+	{ "rr",		selftest_rr },
+};
+
+SELFTEST_SET(rr_selftests, "sched", rr_tests);
+
+void register_rr_commands(void)
+{
+	#ifdef CONFIG_SCHED_RR
+	shell_register_command(&timeslice_command);
+	#endif
+	selftest_register(&rr_selftests);
+}
@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include <kernel/types.h>
+#include <kernel/printk.h>
+#include <kernel/task.h>
+#include <kernel/sched.h>
+#include <kernel/semaphore.h>
+#include <init.h>
+
+static int bench_sizes[] = { 4, 16, 64, 200 };
+
+static int bench_waiter(void *arg)
+{
+	down((struct semaphore *)arg);
+	return 0;
+}
+
+/*
+ * Park nr tasks on a semaphore at a higher priority than the caller and
+ * measure how long one pass through task_schedule() takes while they
+ * are blocked. Returns the average cost in nanoseconds, or -1.
+ */
+static long schedbench_run(int nr, task_t **tasks)
+{
+	struct semaphore	 sem;
+	unsigned long long	 start, end;
+	unsigned int		 prio = current_task->priority;
+	int			 created = 0;
+	int			 i;
+
+	if (prio > 0) {
+		prio--;
+	}
+
+	sema_init(&sem, 0);
+
+	for (i = 0; i < nr; i++) {
+		tasks[i] = task_alloc("bench", BENCH_STACK_SIZE, prio);
+		if (NULL == tasks[i]) {
+			break;
+		}
+		if (task_create(tasks[i], bench_waiter, &sem)) {
+			task_free(tasks[i]);
+			break;
+		}
+		created++;
+	}
+
+	/* let them run into down() */
+	enter_critical_section();
+	task_schedule();
+	exit_critical_section();
+
+	start = current_time_ns();
+	for (i = 0; i < BENCH_LOOPS; i++) {
+		enter_critical_section();
+		task_schedule();
+		exit_critical_section();
+	}
+	end = current_time_ns();
+
+	for (i = 0; i < created; i++) {
+		up(&sem);
+	}
+
+	for (i = 0; i < created; i++) {
+		task_join(tasks[i], NULL);
+	}
+
+	if (created != nr) {
+		printk("schedbench: only %d of %d tasks created\n", created, nr);
+		return -1;
+	}
+
+	return (long)((end - start) / BENCH_LOOPS);
+}
+
+CMD_FUNC(schedbench) {
+	task_t	*tasks[200];
+	long	 cost;
+	int	 i;
+
+	printk("blocked tasks    reschedule (ns)\n");
+	for (i = 0; i < (int)(sizeof(bench_sizes) / sizeof(bench_sizes[0])); i++) {
+		cost = schedbench_run(bench_sizes[i], tasks);
+		if (cost < 0) {
+			return -1;
+		}
+		printk("%13d    %15d\n", bench_sizes[i], (int)cost);
+	}
+
+	return 0;
+}
+
+/* priorities over all the words of the ready bitmap, in no order */
+static const unsigned int picktest_prios[] = { 100, 32, 159, 1, 64, 31, 128, 63, 127, 96 };
+#define PICKTEST_TASKS	(sizeof(picktest_prios) / sizeof(picktest_prios[0]))
+
+static struct {
+	unsigned int	order[PICKTEST_TASKS];
+	int		nr;
+} picktest;
+
+static int picktest_task(void *arg)
+{
+	picktest.order[picktest.nr++] = current_task->priority;
+	return 0;
+}
+
+/*
+ * Tasks parked below us are raised to priorities all over the bitmap
+ * in one critical section; they must then run highest first.
+ */
+static int selftest_pick(void)
+{
+	task_t	*tasks[PICKTEST_TASKS];
+	int	 created;
+	int	 ok;
+	int	 i;
+
+	/* they all have to be above us */
+	for (i = 0; i < (int)PICKTEST_TASKS; i++) {
+		if (picktest_prios[i] >= current_task->priority) {
+			return SELFTEST_SKIP;
+		}
+	}
+
+	memset(&picktest, 0, sizeof(picktest));
+	for (created = 0; created < (int)PICKTEST_TASKS; created++) {
+		tasks[created] = selftest_task("pick", current_task->priority + 1, picktest_task, NULL);
+		if (NULL == tasks[created]) {
+			break;
+		}
+	}
+
+	enter_critical_section();
+	for (i = 0; i < created; i++) {
+		sched_set_priority(tasks[i], picktest_prios[i]);
+	}
+	need_resched = 1;
+	exit_critical_section();
+
+	for (i = 0; i < created; i++) {
+		task_join(tasks[i], NULL);
+	}
+
+	ok = (created == (int)PICKTEST_TASKS) && (picktest.nr == created);
+	for (i = 1; ok && (i < picktest.nr); i++) {
+		ok = picktest.order[i - 1] < picktest.order[i];
+	}
+
+	if (!ok) {
+		printk("%d of %d tasks ran, in priority order:", picktest.nr, (int)PICKTEST_TASKS);
+		for (i = 0; i < picktest.nr; i++) {
+			printk(" %d", picktest.order[i]);
+		}
+		printk("\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/* the reschedule cost must not grow with the number of blocked tasks */
+static int selftest_o1(void)
+{
+	static task_t	*tasks[200];
+	long		 few, many;
+
+	few  = schedbench_run(bench_sizes[0], tasks);
+	many = schedbench_run(bench_sizes[3], tasks);
+	if ((few < 0) || (many < 0)) {
+		return -1;
+	}
+
+	if (many > 2 * few) {
+		printk("reschedule %d ns with %d blocked tasks, %d ns with %d\n",
+		       (int)few, bench_sizes[0], (int)many, bench_sizes[3]);
+		return -1;
+	}
+
+	return 0;
+}
+
+static const struct selftest sched_tests[] = {
+	{ "pick",	selftest_pick },
+	{ "o1",		selftest_o1 },
+};
+
+SELFTEST_SET(sched_selftests, "sched", sched_tests);
+
+SHELL_COMMAND(schedbench_command, "schedbench", "help: measure reschedule cost with 4 to 200 blocked tasks", CMD_FUNC_NAME(schedbench));
+
+void register_sched_commands(void)
+{
+	shell_register_command(&schedbench_command);
+	selftest_register(&sched_selftests);
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include <kernel/types.h>
+#include <kernel/printk.h>
+#include <kernel/task.h>
+#include <init.h>
+
+static LIST_HEAD(selftest_sets);
+
+/* sets run in the order they were registered in */
+void selftest_register(struct selftest_set *set)
+{
+	list_add_tail(&set->list, &selftest_sets);
+}
+
+/* start a task for a check, NULL if there is no memory or pid for it */
+task_t *selftest_task(char *name, unsigned int priority, task_routine entry, void *arg)
+{
+	task_t *task;
+
+	task = task_alloc(name, BENCH_STACK_SIZE, priority);
+	if ((NULL != task) && task_create(task, entry, arg)) {
+		task_free(task);
+		task = NULL;
+	}
+
+	return task;
+}
+
+/* the first word of args is name, or there is none */
+static int selftest_match(const char *args, const char *name)
+{
+	int len = strlen(name);
+
+	if ((NULL == args) || ('\0' == *args)) {
+		return 1;
+	}
+
+	return (0 == strncmp(args, name, len)) && (('\0' == args[len]) || (' ' == args[len]));
+}
+
+/*
+ * selftest              run every check
+ * selftest <set|check>  run one set of checks, or one check, by name
+ *
+ * A check prints what it measured when it fails. The checks start tasks
+ * just above and below the caller's priority, run them from the shell.
+ */
+CMD_FUNC(selftest) {
+	struct selftest_set	*set;
+	const struct selftest	*test;
+	int			 run = 0, failed = 0, skipped = 0;
+	int			 all, ret, i;
+
+	list_for_each_entry(set, &selftest_sets, list) {
+		all = selftest_match(args, set->name);
+		for (i = 0; i < set->nr_tests; i++) {
+			test = &set->tests[i];
+			if (!all && !selftest_match(args, test->name)) {
+				continue;
+			}
+
+			ret = test->func();
+			run++;
+			if (SELFTEST_SKIP == ret) {
+				skipped++;
+			} else if (ret) {
+				failed++;
+			}
+			printk("%-6s %-10s %s\n", set->name, test->name,
+			       (SELFTEST_SKIP == ret) ? "skipped" : (ret ? "FAILED" : "ok"));
+		}
+	}
+
+	if (0 == run) {
+		printk("no check or set named %s\n", args);
+		return -1;
+	}
+
+	printk("%d checks, %d failed, %d skipped\n", run, failed, skipped);
+
+	return failed ? -1 : 0;
+}
+
+SHELL_COMMAND(selftest_command, "selftest", "help: selftest [set|check], behaviour checks of the scheduler, tasks, timers, irqs and ipc", CMD_FUNC_NAME(selftest));
+
+void register_selftest_commands(void)
+{
+	shell_register_command(&selftest_command);
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include <kernel/types.h>
+#include <kernel/printk.h>
+#include <kernel/task.h>
+#include <kernel/semaphore.h>
+#include <init.h>
+#include <arch/arch_task.h>
+
+#define PINGPONG_ROUNDS		1000
+
+struct pingpong {
+	struct semaphore	ping;
+	struct semaphore	pong;
+	int			abort;		/* ping never started, pong gives up */
+	unsigned long long	start;
+	unsigned long long	end;
+};
+
+static int ping_task(void *arg)
+{
+	struct pingpong	*pp = arg;
+	int		 i;
+
+	pp->start = current_time_ns();
+	for (i = 0; i < PINGPONG_ROUNDS; i++) {
+		up(&pp->pong);
+		down(&pp->ping);
+	}
+	pp->end = current_time_ns();
+
+	return 0;
+}
+
+static int pong_task(void *arg)
+{
+	struct pingpong	*pp = arg;
+	int		 i;
+
+	for (i = 0; i < PINGPONG_ROUNDS; i++) {
+		down(&pp->pong);
+		if (pp->abort) {
+			break;
+		}
+		up(&pp->ping);
+	}
+
+	return 0;
+}
+
+/*
+ * Bounce between two tasks through a pair of semaphores, every round
+ * is two context switches. Returns nanoseconds per switch, or -1.
+ */
+static long pingpong_run(void)
+{
+	struct pingpong	 pp;
+	task_t		*ping, *pong;
+	unsigned int	 prio = current_task->priority;
+
+	if (prio > 0) {
+		prio--;
+	}
+
+	sema_init(&pp.ping, 0);
+	sema_init(&pp.pong, 0);
+	pp.abort = 0;
+
+	ping = task_alloc("ping", BENCH_STACK_SIZE, prio);
+	pong = task_alloc("pong", BENCH_STACK_SIZE, prio);
+	if ((NULL == ping) || (NULL == pong)) {
+		goto out;
+	}
+
+	if (task_create(pong, pong_task, &pp)) {
+		goto out;
+	}
+	if (task_create(ping, ping_task, &pp)) {
+		/* pong waits on pp, which is about to go, let it finish first */
+		pp.abort = 1;
+		up(&pp.pong);
+		task_join(pong, NULL);
+		pong = NULL;
+		goto out;
+	}
+
+	task_join(ping, NULL);
+	task_join(pong, NULL);
+
+	return (long)((pp.end - pp.start) / (PINGPONG_ROUNDS * 2));
+
+out:
+	task_free(ping);
+	task_free(pong);
+
+	return -1;
+}
+
+CMD_FUNC(ctxbench) {
+	long	 fast, full;
+
+	arch_force_switch_mm = 1;
+	full = pingpong_run();
+	arch_force_switch_mm = 0;
+	fast = pingpong_run();
+
+	if ((full < 0) || (fast < 0)) {
+		printk("ctxbench: could not create tasks\n");
+		return -1;
+	}
+
+	printk("context switch, mm always switched:  %d ns\n", (int)full);
+	printk("context switch, mm switched on need: %d ns\n", (int)fast);
+
+	return 0;
+}
+
+/* the mm switch is skipped when the page directory stays, so it must cost less */
+static int selftest_mm(void)
+{
+	long	 fast, full;
+
+	arch_force_switch_mm = 1;
+	full = pingpong_run();
+	arch_force_switch_mm = 0;
+	fast = pingpong_run();
+
+	if ((full < 0) || (fast < 0) || (fast >= full)) {
+		printk("context switch %d ns with the mm switch, %d ns without\n",
+		       (int)full, (int)fast);
+		return -1;
+	}
+
+	return 0;
+}
+
+static const struct selftest switch_tests[] = {
+	{ "mm",		selftest_mm },
+};
+
+SELFTEST_SET(switch_selftests, "sched", switch_tests);
+
+SHELL_COMMAND(ctxbench_command, "ctxbench", "help: ping-pong context switch latency with and without the mm switch", CMD_FUNC_NAME(ctxbench));
+
+void register_switch_commands(void)
+{
+	shell_register_command(&ctxbench_command);
+	selftest_register(&switch_selftests);
+}
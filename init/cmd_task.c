@@ -0,0 +1,516 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include <kernel/types.h>
+#include <kernel/printk.h>
+#include <kernel/task.h>
+#include <kernel/sched.h>
+#include <kernel/timer.h>
+#include <kernel/semaphore.h>
+#include <init.h>
+
+static const char *task_state_name(task_t *task)
+{
+	switch (task->state) {
+	case RUNNING:	return (task == current_task) ? "run" : "ready";
+	case READY:	return "ready";
+	case SLEEPING:	return "sleep";
+	case SUSPENDED:	return "susp";
+	case BLOCKED:	return "block";
+	case CREATING:	return "new";
+	case EXITED:	return "exit";
+	default:	return "?";
+	}
+}
+
+/* percent of elapsed, in tenths */
+static int permille(unsigned long long part, unsigned long long whole)
+{
+	if (0 == whole) {
+		return 0;
+	}
+
+	return (int)((part * 1000) / whole);
+}
+
+#define PS_MAX_TASKS	64
+
+struct ps_sample {
+	int			 pid;
+	char			 name[32];
+	const char		*state;
+	unsigned int		 priority;
+	int			 cpu;		/* permille */
+	unsigned long long	 runtime;
+	unsigned long		 nvcsw;
+	unsigned long		 nivcsw;
+	unsigned long		 latency;
+	unsigned long		 latency_max;
+	unsigned long		 stack;		/* high-water, bytes */
+};
+
+/*
+ * Copy the fields under the lock and print them after, the listing is
+ * far too slow to run with interrupts off. Stacks are scanned one task
+ * per critical section, the task may have gone in between.
+ */
+CMD_FUNC(ps) {
+	static struct ps_sample	 samples[PS_MAX_TASKS];
+	struct ps_sample	*ps;
+	task_t			*task;
+	unsigned long long	 now;
+	int			 nr = 0;
+	int			 i;
+
+	enter_critical_section();
+	task_account_tick(current_task);
+	now = current_time_hires();
+	list_for_each_entry(task, &task_list, task_list) {
+		if (nr == PS_MAX_TASKS) {
+			break;
+		}
+		ps = &samples[nr++];
+		ps->pid		= task->pid;
+		memcpy(ps->name, task->name, sizeof(ps->name));
+		ps->state	= task_state_name(task);
+		ps->priority	= task->priority;
+		ps->cpu		= permille(task->runtime, now - task->start_time);
+		ps->runtime	= task->runtime;
+		ps->nvcsw	= task->nvcsw;
+		ps->nivcsw	= task->nivcsw;
+		ps->latency	= task->wakeup_latency;
+		ps->latency_max	= task->wakeup_latency_max;
+	}
+	exit_critical_section();
+
+	for (i = 0; i < nr; i++) {
+		enter_critical_section();
+		task = task_find_by_pid(samples[i].pid);
+		samples[i].stack = task ? task_stack_used(task) : 0;
+		exit_critical_section();
+	}
+
+	printk(" pid name             state prio   cpu%%   runtime(ms)     vcsw    ivcsw  lat(us) max(us)  stack\n");
+	for (i = 0; i < nr; i++) {
+		ps = &samples[i];
+		printk("%4d %-16s %-5s %4d %4d.%d %13d %8d %8d %8d %7d %6d\n",
+		       ps->pid, ps->name, ps->state,
+		       ps->priority, ps->cpu / 10, ps->cpu % 10,
+		       (int)(ps->runtime / 1000),
+		       (int)ps->nvcsw, (int)ps->nivcsw,
+		       (int)ps->latency, (int)ps->latency_max, (int)ps->stack);
+	}
+
+	return 0;
+}
+
+/*
+ * Stack use of every task since it was created. The suggestion leaves a
+ * quarter of headroom over the high-water mark, rounded up to 1k.
+ */
+CMD_FUNC(stacks) {
+	task_t		*task;
+	unsigned long	 used;
+	unsigned long	 suggest;
+
+	printk(" pid name                 size  high-water      %%  suggested\n");
+	list_for_each_entry(task, &task_list, task_list) {
+		if (NULL == task->stack) {
+			continue;
+		}
+		used	= task_stack_used(task);
+		suggest = ((used + used / 4) + 1023) & ~1023UL;
+		printk("%4d %-16s %8d %11d %6d %10d\n", task->pid, task->name,
+		       task->stack_size, (int)used,
+		       (int)(used * 100 / task->stack_size), (int)suggest);
+	}
+
+	return 0;
+}
+
+#define TOP_MAX_TASKS	64
+
+struct top_sample {
+	int			pid;
+	char			name[32];
+	unsigned long long	runtime;
+	unsigned long		nvcsw;
+	unsigned long		nivcsw;
+};
+
+static int top_snapshot(struct top_sample *samples)
+{
+	task_t	*task;
+	int	 nr = 0;
+
+	enter_critical_section();
+	task_account_tick(current_task);
+	list_for_each_entry(task, &task_list, task_list) {
+		if (nr == TOP_MAX_TASKS) {
+			break;
+		}
+		samples[nr].pid	    = task->pid;
+		memcpy(samples[nr].name, task->name, sizeof(samples[nr].name));
+		samples[nr].runtime = task->runtime;
+		samples[nr].nvcsw   = task->nvcsw;
+		samples[nr].nivcsw  = task->nivcsw;
+		nr++;
+	}
+	exit_critical_section();
+
+	return nr;
+}
+
+/*
+ * top [n]    n one second samples of per-task cpu usage and context
+ *            switches over the interval, default 1
+ */
+CMD_FUNC(top) {
+	static struct top_sample	 before[TOP_MAX_TASKS];
+	static struct top_sample	 after[TOP_MAX_TASKS];
+	unsigned long long		 start, elapsed;
+	int				 rounds = 1;
+	int				 nr_before, nr_after;
+	int				 i, j, cpu;
+
+	if (args && *args) {
+		rounds = simple_strtoul(args, NULL, 10);
+	}
+
+	while (rounds-- > 0) {
+		nr_before = top_snapshot(before);
+		start	  = current_time_hires();
+		task_sleep(1000);
+		nr_after  = top_snapshot(after);
+		elapsed	  = current_time_hires() - start;
+
+		printk(" pid name               cpu%%     vcsw    ivcsw\n");
+		for (i = 0; i < nr_after; i++) {
+			for (j = 0; j < nr_before; j++) {
+				if (before[j].pid == after[i].pid) {
+					break;
+				}
+			}
+			if (j == nr_before) {
+				continue;
+			}
+			cpu = permille(after[i].runtime - before[j].runtime, elapsed);
+			printk("%4d %-16s %4d.%d %8d %8d\n", after[i].pid, after[i].name,
+			       cpu / 10, cpu % 10,
+			       (int)(after[i].nvcsw - before[j].nvcsw),
+			       (int)(after[i].nivcsw - before[j].nivcsw));
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * The accounting hook runs on every context switch, so keep an eye on
+ * what it costs: time it against a dummy pair of tasks and compare with
+ * TASK_ACCT_BUDGET_NS.
+ */
+CMD_FUNC(acctbench) {
+	static task_t		 a, b;
+	unsigned long long	 start, end, woken;
+	long			 cost;
+	int			 i;
+
+	a.state = SLEEPING;
+	b.state = RUNNING;
+
+	enter_critical_section();
+	woken = current_time_hires();
+	start = current_time_ns();
+	for (i = 0; i < BENCH_LOOPS; i++) {
+		b.wakeup_time = woken;
+		task_account_switch(&a, &b);
+		a.wakeup_time = woken;
+		task_account_switch(&b, &a);
+	}
+	end = current_time_ns();
+	exit_critical_section();
+
+	cost = (long)((end - start) / (BENCH_LOOPS * 2));
+	printk("accounting: %d ns per switch, budget %d ns: %s\n",
+	       (int)cost, TASK_ACCT_BUDGET_NS,
+	       (cost <= TASK_ACCT_BUDGET_NS) ? "ok" : "OVER BUDGET");
+
+	return (cost <= TASK_ACCT_BUDGET_NS) ? 0 : -1;
+}
+
+/*
+ * idlestat            idle residency and wakeups since boot or reset
+ * idlestat reset      start counting again
+ * idlestat on|off     stop the tick while idle or keep it running
+ */
+CMD_FUNC(idlestat) {
+	static unsigned long long	 since;
+	unsigned long long		 elapsed;
+	int				 residency;
+
+	if (args && (0 == strncmp(args, "reset", 5))) {
+		enter_critical_section();
+		memset(&idle_stats, 0, sizeof(idle_stats));
+		since = current_time_hires();
+		exit_critical_section();
+		return 0;
+	}
+
+	#ifdef CONFIG_TICKLESS
+	if (args && (0 == strncmp(args, "on", 2))) {
+		tickless_enabled = 1;
+		return 0;
+	}
+
+	if (args && (0 == strncmp(args, "off", 3))) {
+		tickless_enabled = 0;
+		return 0;
+	}
+	#endif
+
+	elapsed	  = current_time_hires() - since;
+	residency = permille(idle_stats.residency, elapsed);
+
+	#ifdef CONFIG_TICKLESS
+	printk("tickless:      %s\n", tickless_enabled ? "on" : "off");
+	#endif
+	printk("elapsed:       %d ms\n", (int)(elapsed / 1000));
+	printk("idle:          %d ms (%d.%d%%)\n", (int)(idle_stats.residency / 1000),
+	       residency / 10, residency % 10);
+	printk("wakeups:       %d (%d/s)\n", (int)idle_stats.wakeups,
+	       elapsed ? (int)((idle_stats.wakeups * 1000000ULL) / elapsed) : 0);
+	printk("tick stopped:  %d\n", (int)idle_stats.tickless);
+	printk("timer wakeups: %d\n", (int)idle_stats.timer_wakeups);
+
+	return 0;
+}
+
+#define ACCTTEST_BUSY_US	20000
+#define STACKTEST_BYTES		512
+#define JOINTEST_RET		42
+
+static int acct_busy(void *arg)
+{
+	unsigned long long end = current_time_hires() + ACCTTEST_BUSY_US;
+
+	while (current_time_hires() < end)
+		;
+
+	enter_critical_section();
+	task_account_tick(current_task);
+	*(unsigned long long *)arg = current_task->runtime;
+	exit_critical_section();
+
+	return 0;
+}
+
+/* a task that spins for ACCTTEST_BUSY_US is charged that, give or take 10% */
+static int selftest_acct(void)
+{
+	unsigned long long	 runtime = 0;
+	task_t			*task;
+
+	task = selftest_task("acct", current_task->priority - 1, acct_busy, &runtime);
+	if (NULL == task) {
+		return -1;
+	}
+	task_join(task, NULL);
+
+	if ((runtime < ACCTTEST_BUSY_US * 9 / 10) || (runtime > ACCTTEST_BUSY_US * 11 / 10)) {
+		printk("spun %d us, charged %d us\n", ACCTTEST_BUSY_US, (int)runtime);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int stack_toucher(void *arg)
+{
+	volatile unsigned char	buf[STACKTEST_BYTES];
+	int			i;
+
+	for (i = 0; i < STACKTEST_BYTES; i++) {
+		buf[i] = (unsigned char)i;
+	}
+	down((struct semaphore *)arg);
+
+	return buf[0];
+}
+
+/* the high-water mark covers what the task wrote, not the whole stack */
+static int selftest_stack(void)
+{
+	struct semaphore	 sem;
+	task_t			*task;
+	unsigned long		 used;
+
+	sema_init(&sem, 0);
+	task = selftest_task("stack", current_task->priority - 1, stack_toucher, &sem);
+	if (NULL == task) {
+		return -1;
+	}
+
+	/* let it run into down() */
+	enter_critical_section();
+	task_schedule();
+	exit_critical_section();
+
+	used = task_stack_used(task);
+	up(&sem);
+	task_join(task, NULL);
+
+	if ((used < STACKTEST_BYTES) || (used >= BENCH_STACK_SIZE)) {
+		printk("wrote %d bytes, high-water %d of %d\n", STACKTEST_BYTES,
+		       (int)used, BENCH_STACK_SIZE);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int join_exit(void *arg)
+{
+	return JOINTEST_RET;
+}
+
+static int detach_exit(void *arg)
+{
+	up((struct semaphore *)arg);
+	return JOINTEST_RET;
+}
+
+/*
+ * task_join() hands back the exit code. A detached task cannot be
+ * joined, the reaper frees it once it has exited and its control block
+ * goes to the next task_alloc().
+ */
+static int selftest_join(void)
+{
+	struct semaphore	 exited;
+	task_t			*task;
+	task_t			*reused;
+	int			 ret = 0;
+	int			 pid;
+	int			 gone;
+
+	task = selftest_task("join", current_task->priority - 1, join_exit, NULL);
+	if (NULL == task) {
+		return -1;
+	}
+	if (task_join(task, &ret) || (JOINTEST_RET != ret)) {
+		printk("join returned exit code %d, not %d\n", ret, JOINTEST_RET);
+		return -1;
+	}
+
+	/*
+	 * Above us, so it runs once we block and exits right after the up().
+	 * The reaper outranks both of us and frees it before we are back.
+	 */
+	sema_init(&exited, 0);
+	task = selftest_task("detach", current_task->priority - 1, detach_exit, &exited);
+	if (NULL == task) {
+		return -1;
+	}
+	pid = task->pid;
+	if (task_detach(task) || (0 == task_join(task, NULL))) {
+		printk("joined a detached task\n");
+		return -1;
+	}
+
+	down(&exited);
+
+	enter_critical_section();
+	gone = (NULL == task_find_by_pid(pid));
+	exit_critical_section();
+
+	if (!gone) {
+		printk("detached task %d was not reaped\n", pid);
+		return -1;
+	}
+
+	reused = task_alloc("reuse", BENCH_STACK_SIZE, current_task->priority);
+	if (NULL == reused) {
+		return -1;
+	}
+	gone = (reused == task);
+	task_free(reused);
+
+	if (!gone) {
+		printk("control block of task %d was not handed out again\n", pid);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* TASK_DEFINE() tasks are static and so never handed to the allocator */
+static int selftest_static(void)
+{
+	static const char	*names[] = { "reaper", "timer" };
+	task_t			*task;
+	int			 found = 0;
+	int			 i;
+
+	enter_critical_section();
+	list_for_each_entry(task, &task_list, task_list) {
+		for (i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++) {
+			if ((0 == strcmp(task->name, names[i])) && (task->flags & TASK_STATIC)) {
+				found++;
+			}
+		}
+	}
+	exit_critical_section();
+
+	if (found != (int)(sizeof(names) / sizeof(names[0]))) {
+		printk("%d of the reaper and timer tasks are static\n", found);
+		return -1;
+	}
+
+	return 0;
+}
+
+static const struct selftest task_tests[] = {
+	{ "acct",	selftest_acct },
+	{ "stack",	selftest_stack },
+	{ "join",	selftest_join },
+	{ "static",	selftest_static },
+};
+
+SELFTEST_SET(task_selftests, "task", task_tests);
+
+SHELL_COMMAND(ps_command, "ps", "help: list tasks with cpu usage, switches, wakeup latency and stack high-water", CMD_FUNC_NAME(ps));
+SHELL_COMMAND(top_command, "top", "help: top [n], per-task cpu usage over n one second samples", CMD_FUNC_NAME(top));
+SHELL_COMMAND(acctbench_command, "acctbench", "help: measure cpu accounting cost per context switch", CMD_FUNC_NAME(acctbench));
+SHELL_COMMAND(stacks_command, "stacks", "help: per-task stack high-water marks and suggested sizes", CMD_FUNC_NAME(stacks));
+SHELL_COMMAND(idlestat_command, "idlestat", "help: idlestat [reset|on|off], idle residency and wakeups", CMD_FUNC_NAME(idlestat));
+
+void register_task_commands(void)
+{
+	shell_register_command(&ps_command);
+	shell_register_command(&top_command);
+	shell_register_command(&acctbench_command);
+	shell_register_command(&idlestat_command);
+	shell_register_command(&stacks_command);
+	selftest_register(&task_selftests);
+}
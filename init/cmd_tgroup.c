@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include <kernel/types.h>
+#include <kernel/printk.h>
+#include <kernel/task.h>
+#include <kernel/sched.h>
+#include <init.h>
+
+static void tgroup_show(void)
+{
+	struct task_group	*group;
+	task_t			*task;
+	int			 i;
+
+	printk("name             budget   period  remain   runtime throttled throttled\n");
+	printk("                   (ms)     (ms)    (ms)      (ms)     times      (ms)\n");
+	for (i = 0; i < TASK_GROUP_MAX; i++) {
+		group = &task_groups[i];
+		if ('\0' == group->name[0]) {
+			continue;
+		}
+		printk("%-16s %6d %8d %7d %9d %9d %9d\n", group->name,
+		       (int)(group->budget / 1000), (int)(group->period / 1000),
+		       (int)(group->remaining / 1000), (int)(group->runtime / 1000),
+		       (int)group->nr_throttled, (int)(group->throttled_time / 1000));
+		list_for_each_entry(task, &task_list, task_list) {
+			if (task->group == group) {
+				printk("    %4d %s\n", task->pid, task->name);
+			}
+		}
+	}
+}
+
+/*
+ * tgroup                                   groups, budgets and accounting
+ * tgroup create <name> <budget> <period>   reserve budget ms every period ms
+ * tgroup set <name> <budget> <period>      change a reservation
+ * tgroup destroy <name>                    remove an empty group
+ * tgroup add <name> <pid>                  move a task into a group
+ * tgroup del <pid>                         take a task out of its group
+ */
+CMD_FUNC(tgroup) {
+	struct task_group	*group;
+	task_t			*task = NULL;
+	char			 name[16];
+	char			*arg;
+	unsigned long		 budget, period;
+
+	if ((NULL == args) || ('\0' == *args)) {
+		tgroup_show();
+		return 0;
+	}
+
+	arg = shell_next_arg(args);
+
+	if (0 == strncmp(args, "del", 3)) {
+		task = task_find_by_pid(simple_strtoul(arg, NULL, 10));
+		if (NULL == task) {
+			printk("no such task\n");
+			return -1;
+		}
+		return task_group_attach(task, NULL);
+	}
+
+	shell_copy_arg(name, sizeof(name), arg);
+	group = task_group_find(name);
+	arg   = shell_next_arg(arg);
+
+	if (0 == strncmp(args, "add", 3)) {
+		task = task_find_by_pid(simple_strtoul(arg, NULL, 10));
+		if ((NULL == group) || (NULL == task)) {
+			printk("no such group or task\n");
+			return -1;
+		}
+		return task_group_attach(task, group);
+	}
+
+	if (0 == strncmp(args, "destroy", 7)) {
+		if (task_group_destroy(group)) {
+			printk("no group %s, or it still has tasks\n", name);
+			return -1;
+		}
+		return 0;
+	}
+
+	budget = simple_strtoul(arg, NULL, 10) * 1000;
+	arg    = shell_next_arg(arg);
+	period = simple_strtoul(arg, NULL, 10) * 1000;
+
+	if (0 == strncmp(args, "create", 6)) {
+		if (NULL == task_group_create(name, budget, period)) {
+			printk("cannot create group %s\n", name);
+			return -1;
+		}
+		return 0;
+	}
+
+	if (0 == strncmp(args, "set", 3)) {
+		if (task_group_set(group, budget, period)) {
+			printk("no group %s, or invalid budget or period\n", name);
+			return -1;
+		}
+		return 0;
+	}
+
+	printk("usage: tgroup [create|set <name> <budget> <period>|destroy <name>|add <name> <pid>|del <pid>]\n");
+	return -1;
+}
+
+#define GROUPTEST_BUDGET	20	/* ms */
+#define GROUPTEST_PERIOD	100
+#define GROUPTEST_SPIN		400
+#define GROUPTEST_SHARE		(GROUPTEST_SPIN * GROUPTEST_BUDGET / GROUPTEST_PERIOD)
+
+static int grouptest_spin(void *arg)
+{
+	unsigned long long end = current_time_hires() + GROUPTEST_SPIN * 1000;
+
+	while (current_time_hires() < end)
+		;
+
+	enter_critical_section();
+	task_account_tick(current_task);
+	*(unsigned long long *)arg = current_task->runtime;
+	exit_critical_section();
+
+	return 0;
+}
+
+/*
+ * A task spinning in a group with a 20% reservation gets about 20% of
+ * the time it spins for, at most twice that with the tick's rounding.
+ */
+static int selftest_tgroup(void)
+{
+	struct task_group	*group;
+	task_t			*task;
+	unsigned long long	 runtime = 0;
+	int			 ms;
+
+	group = task_group_create("selftest", GROUPTEST_BUDGET * 1000, GROUPTEST_PERIOD * 1000);
+	if (NULL == group) {
+		printk("cannot create group selftest\n");
+		return -1;
+	}
+
+	task = selftest_task("tgroup", current_task->priority - 1, grouptest_spin, &runtime);
+	if (NULL != task) {
+		task_group_attach(task, group);
+		task_join(task, NULL);
+	}
+	task_group_destroy(group);
+
+	ms = (int)(runtime / 1000);
+	if ((NULL == task) || (ms < GROUPTEST_SHARE / 2) || (ms > GROUPTEST_SHARE * 2)) {
+		printk("ran %d ms of %d, reserved %d\n", ms, GROUPTEST_SPIN, GROUPTEST_SHARE);
+		return -1;
+	}
+
+	return 0;
+}
+
+static const struct selftest tgroup_tests[] = {
+	{ "tgroup",	selftest_tgroup },
+};
+
+SELFTEST_SET(tgroup_selftests, "sched", tgroup_tests);
+
+SHELL_COMMAND(tgroup_command, "tgroup", "help: tgroup [create|set|destroy|add|del], cpu reservations of task groups", CMD_FUNC_NAME(tgroup));
+
+void register_tgroup_commands(void)
+{
+	shell_register_command(&tgroup_command);
+	selftest_register(&tgroup_selftests);
+}
@@ -0,0 +1,721 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include <kernel/types.h>
+#include <kernel/printk.h>
+#include <kernel/task.h>
+#include <kernel/timer.h>
+#include <kernel/irq.h>
+#include <arch/timer.h>
+#include <init.h>
+#include <mm/malloc.h>
+
+#define TIMERBENCH_DEFAULT	4000
+
+static volatile int timerbench_fired;
+
+static handler_return timerbench_function(timer_t *timer, unsigned long now, void *arg)
+{
+	timerbench_fired++;
+
+	return INT_NO_RESCHEDULE;
+}
+
+/*
+ * timerbench [n]: n timers at pseudo-random delays, time to add and to
+ * delete them all, then n timers expiring over two seconds and the
+ * timer softirq time each cost, callback included.
+ */
+CMD_FUNC(timerbench) {
+	timer_t			*timers;
+	unsigned long long	 start, add, del;
+	unsigned long		 seed = 12345;
+	int			 n = TIMERBENCH_DEFAULT;
+	int			 i, wait;
+
+	if (args && *args) {
+		n = simple_strtoul(args, NULL, 10);
+	}
+	if (n <= 0) {
+		return -1;
+	}
+
+	timers = (timer_t *)kmalloc(n * sizeof(*timers));
+	if (NULL == timers) {
+		printk("timerbench: no memory for %d timers\n", n);
+		return -1;
+	}
+	for (i = 0; i < n; i++) {
+		init_timer_value(&timers[i]);
+	}
+
+	/* delays up to ten minutes, so none expires while we measure */
+	start = current_time_ns();
+	for (i = 0; i < n; i++) {
+		seed = seed * 1103515245 + 12345;
+		oneshot_timer_add(&timers[i], 10000 + (seed >> 8) % 600000,
+				  (timer_function)timerbench_function, NULL);
+	}
+	add = current_time_ns() - start;
+
+	start = current_time_ns();
+	for (i = 0; i < n; i++) {
+		timer_delete(&timers[i]);
+	}
+	del = current_time_ns() - start;
+
+	printk("%d timers, add %d ns, delete %d ns per timer\n", n,
+	       (int)(add / n), (int)(del / n));
+
+	enter_critical_section();
+	memset((void *)&timer_stats, 0, sizeof(timer_stats));
+	timerbench_fired = 0;
+	exit_critical_section();
+
+	for (i = 0; i < n; i++) {
+		seed = seed * 1103515245 + 12345;
+		oneshot_timer_add(&timers[i], 10 + (seed >> 8) % 2000,
+				  (timer_function)timerbench_function, NULL);
+	}
+	for (wait = 0; (timerbench_fired < n) && (wait < 40); wait++) {
+		task_sleep(100);
+	}
+
+	printk("expired %d of %d, %d ns per timer, %d cascaded\n",
+	       timerbench_fired, n,
+	       timer_stats.expired ? (int)(timer_stats.softirq_time * 1000 / timer_stats.expired) : 0,
+	       (int)timer_stats.cascaded);
+
+	for (i = 0; i < n; i++) {
+		timer_delete(&timers[i]);
+	}
+	kfree((void *)timers);
+
+	return 0;
+}
+
+#define TIMERACC_DEFAULT	64
+#define TIMERACC_PERIOD		10	/* ms */
+#define TIMERACC_PERIODS	100
+#define TIMERACC_LATE_US	1000	/* the timers' clock counts in ms */
+
+struct timeracc_late {
+	unsigned long		 max;	/* us past the deadline */
+	unsigned long long	 sum;
+	int			 nr;
+};
+
+static struct {
+	struct timeracc_late	 batch;
+	int			 fired;
+	int			 split;		/* ran in another pass than the first */
+	unsigned long		 now;
+	struct timeracc_late	 periodic;
+	unsigned long		 first;		/* deadline of the first period */
+	int			 drift;		/* periods off first + k * period */
+} timeracc;
+
+static void timeracc_record(struct timeracc_late *l, unsigned long deadline)
+{
+	unsigned long long	 ns = current_time_ns();
+	unsigned long long	 ms = ns / NSEC_PER_MSEC;
+	unsigned long		 late;
+
+	late = (unsigned long)((ns - ms * NSEC_PER_MSEC) / NSEC_PER_USEC) +
+	       ((unsigned long)ms - deadline) * 1000;
+	if (late > l->max) {
+		l->max = late;
+	}
+	l->sum += late;
+	l->nr++;
+}
+
+static handler_return timeracc_function(timer_t *timer, unsigned long now, void *arg)
+{
+	timeracc_record(&timeracc.batch, timer->expired_time);
+	if (0 == timeracc.fired++) {
+		timeracc.now = now;
+	} else if (now != timeracc.now) {
+		timeracc.split++;
+	}
+
+	/* half of them ask for a reschedule, the rest must still run in this pass */
+	return ((unsigned long)arg & 1) ? INT_RESCHEDULE : INT_NO_RESCHEDULE;
+}
+
+static handler_return timeracc_periodic(timer_t *timer, unsigned long now, void *arg)
+{
+	if (0 == timeracc.periodic.nr) {
+		timeracc.first = timer->expired_time;
+	} else if (timer->expired_time != timeracc.first + timeracc.periodic.nr * TIMERACC_PERIOD) {
+		timeracc.drift++;
+	}
+	timeracc_record(&timeracc.periodic, timer->expired_time);
+
+	return INT_RESCHEDULE;
+}
+
+/*
+ * n timers due in the same ms next to a 10ms periodic timer. All n must
+ * run in one pass whatever their callbacks return, the periodic one
+ * must keep to its deadlines, and none may be late by more than
+ * TIMERACC_LATE_US.
+ */
+static int timeracc_run(int n)
+{
+	timer_t		*timers;
+	timer_t		 periodic;
+	unsigned long	 target;
+	int		 ok;
+	int		 i;
+
+	timers = (timer_t *)kmalloc(n * sizeof(*timers));
+	if (NULL == timers) {
+		printk("timeracc: no memory for %d timers\n", n);
+		return -1;
+	}
+
+	memset(&timeracc, 0, sizeof(timeracc));
+	init_timer_value(&periodic);
+	periodic_timer_add(&periodic, TIMERACC_PERIOD,
+			   (timer_function)timeracc_periodic, NULL);
+
+	target = (unsigned long)current_time() + 50;
+	for (i = 0; i < n; i++) {
+		init_timer_value(&timers[i]);
+		do {
+			/* again if the clock ticked over in between */
+			timer_delete(&timers[i]);
+			oneshot_timer_add(&timers[i], target - (unsigned long)current_time(),
+					  (timer_function)timeracc_function, (void *)(unsigned long)i);
+		} while (timers[i].expired_time != target);
+	}
+
+	task_sleep(TIMERACC_PERIOD * TIMERACC_PERIODS + TIMERACC_PERIOD / 2);
+	timer_delete(&periodic);
+	for (i = 0; i < n; i++) {
+		timer_delete(&timers[i]);
+	}
+	kfree((void *)timers);
+
+	printk("co-expiring: %d of %d fired, %d in a later pass, late max %d us, avg %d us\n",
+	       timeracc.fired, n, timeracc.split, (int)timeracc.batch.max,
+	       timeracc.batch.nr ? (int)(timeracc.batch.sum / timeracc.batch.nr) : 0);
+	printk("periodic:    %d periods, %d off their deadline, late max %d us, avg %d us\n",
+	       timeracc.periodic.nr, timeracc.drift, (int)timeracc.periodic.max,
+	       timeracc.periodic.nr ? (int)(timeracc.periodic.sum / timeracc.periodic.nr) : 0);
+
+	ok = (timeracc.fired == n) && (0 == timeracc.split) && (0 == timeracc.drift) &&
+	     (timeracc.periodic.nr >= TIMERACC_PERIODS) &&
+	     (timeracc.batch.max <= TIMERACC_LATE_US) &&
+	     (timeracc.periodic.max <= TIMERACC_LATE_US);
+	printk("%s\n", ok ? "ok" : "FAILED");
+
+	return ok ? 0 : -1;
+}
+
+/* timeracc [n]: expiry accuracy of n co-expiring timers, see timeracc_run() */
+CMD_FUNC(timeracc) {
+	int n = TIMERACC_DEFAULT;
+
+	if (args && *args) {
+		n = simple_strtoul(args, NULL, 10);
+	}
+	if (n <= 0) {
+		return -1;
+	}
+
+	return timeracc_run(n);
+}
+
+CMD_FUNC(timerstat) {
+	if (args && (0 == strncmp(args, "reset", 5))) {
+		enter_critical_section();
+		memset(&timer_stats, 0, sizeof(timer_stats));
+		exit_critical_section();
+		return 0;
+	}
+
+	printk("added:         %d\n", (int)timer_stats.added);
+	printk("deleted:       %d\n", (int)timer_stats.deleted);
+	printk("expired:       %d in %d passes\n",
+	       (int)timer_stats.expired, (int)timer_stats.passes);
+	printk("cascaded:      %d\n", (int)timer_stats.cascaded);
+	printk("overruns:      %d\n", (int)timer_stats.overruns);
+	printk("slack moved:   %d\n", (int)timer_stats.slack_moved);
+	printk("wakeups saved: %d\n", (int)timer_stats.wakeups_saved);
+	printk("soft:          %d queued, %d run, %d put off\n",
+	       (int)timer_stats.soft_queued, (int)timer_stats.soft_run,
+	       (int)timer_stats.soft_deferred);
+	printk("softirq time:  %d us\n", (int)timer_stats.softirq_time);
+
+	return 0;
+}
+
+#define SLACKBENCH_TASKS	8
+#define SLACKBENCH_MS		1000
+#define SLACKBENCH_SLACK	10	/* ms */
+
+static unsigned long slackbench_slack;
+
+/* sleeps of 10, 13, 16 ... ms so that few of them coincide by themselves */
+static int slack_sleeper(void *arg)
+{
+	unsigned long	 period = 10 + 3 * (unsigned long)arg;
+	unsigned long	 end    = (unsigned long)current_time() + SLACKBENCH_MS;
+
+	while ((signed long)(end - (unsigned long)current_time()) > 0) {
+		task_sleep_slack(period, slackbench_slack);
+	}
+
+	return 0;
+}
+
+/* timer passes and wakeups saved by SLACKBENCH_TASKS sleepers, or -1 */
+static int slackbench_run(unsigned long slack, unsigned long *passes, unsigned long *saved)
+{
+	task_t		*tasks[SLACKBENCH_TASKS];
+	unsigned long	 passes0 = timer_stats.passes;
+	unsigned long	 saved0  = timer_stats.wakeups_saved;
+	unsigned int	 prio    = current_task->priority;
+	int		 created = 0;
+	int		 i;
+
+	if (prio > 0) {
+		prio--;
+	}
+
+	slackbench_slack = slack;
+	for (i = 0; i < SLACKBENCH_TASKS; i++) {
+		tasks[i] = task_alloc("slack", BENCH_STACK_SIZE, prio);
+		if (NULL == tasks[i]) {
+			break;
+		}
+		if (task_create(tasks[i], slack_sleeper, (void *)(unsigned long)i)) {
+			task_free(tasks[i]);
+			break;
+		}
+		created++;
+	}
+
+	for (i = 0; i < created; i++) {
+		task_join(tasks[i], NULL);
+	}
+
+	if (created != SLACKBENCH_TASKS) {
+		printk("slackbench: only %d of %d tasks created\n", created, SLACKBENCH_TASKS);
+		return -1;
+	}
+
+	*passes = timer_stats.passes - passes0;
+	*saved  = timer_stats.wakeups_saved - saved0;
+
+	return 0;
+}
+
+/*
+ * slackbench [slack]: SLACKBENCH_TASKS tasks sleeping in a loop for a
+ * second, first exactly and then with slack ms of slack. Fewer timer
+ * passes the second time is fewer times the CPU had to leave idle.
+ */
+CMD_FUNC(slackbench) {
+	unsigned long	 slack = SLACKBENCH_SLACK;
+	unsigned long	 passes, saved;
+	unsigned long	 runs[2] = { 0, 0 };
+	int		 i;
+
+	if (args && *args) {
+		slack = simple_strtoul(args, NULL, 10);
+	}
+	runs[1] = slack;
+
+	printk("slack (ms)    timer passes    wakeups saved\n");
+	for (i = 0; i < 2; i++) {
+		if (slackbench_run(runs[i], &passes, &saved)) {
+			return -1;
+		}
+		printk("%10d    %12d    %13d\n", (int)runs[i], (int)passes, (int)saved);
+	}
+
+	return 0;
+}
+
+#define SOFTTIMER_BUSY_US	2000
+
+static handler_return softtimer_busy(timer_t *timer, unsigned long now, void *arg)
+{
+	unsigned long long end = current_time_hires() + (unsigned long)arg;
+
+	while (current_time_hires() < end)
+		;
+
+	return INT_NO_RESCHEDULE;
+}
+
+/*
+ * softtimer [us]: a timer whose function spins for us, run hard and then
+ * soft. Hard, the longest softirq takes at least as long; soft, it must
+ * not, the timer task does the spinning.
+ */
+CMD_FUNC(softtimer) {
+	timer_t		 timer;
+	unsigned long	 us = SOFTTIMER_BUSY_US;
+	unsigned long	 longest[2];
+	int		 soft;
+	int		 ok;
+
+	if (args && *args) {
+		us = simple_strtoul(args, NULL, 10);
+	}
+
+	for (soft = 0; soft < 2; soft++) {
+		init_timer_value(&timer);
+		timer_set_soft(&timer, soft);
+
+		enter_critical_section();
+		irq_stats.softirq_max = 0;
+		exit_critical_section();
+
+		oneshot_timer_add(&timer, 10, (timer_function)softtimer_busy, (void *)us);
+		task_sleep(20 + us / 1000);
+		timer_delete(&timer);
+
+		longest[soft] = irq_stats.softirq_max;
+		printk("%s: longest softirq %d us\n", soft ? "soft" : "hard", (int)longest[soft]);
+	}
+
+	ok = (longest[0] >= us) && (longest[1] < us);
+	printk("%s\n", ok ? "ok" : "FAILED");
+
+	return ok ? 0 : -1;
+}
+
+#define TICK_US			(1000000 / HZ)
+
+/* one in each of the root's first and later slots, and a level up */
+static const unsigned long wheeltest_delays[] = { 700, 3, 300, 257, 40, 513 };
+#define WHEELTEST_TIMERS	(sizeof(wheeltest_delays) / sizeof(wheeltest_delays[0]))
+#define WHEELTEST_DELETED	100	/* ms, deleted before it is due */
+
+static struct {
+	int		order[WHEELTEST_TIMERS];
+	int		nr;
+	int		early;
+	int		deleted;	/* the deleted one expired anyway */
+	unsigned long	late_max;	/* ms */
+} wheeltest;
+
+static handler_return wheeltest_function(timer_t *timer, unsigned long now, void *arg)
+{
+	long late = (long)((unsigned long)current_time() - timer->expired_time);
+
+	if (late < 0) {
+		wheeltest.early++;
+	} else if ((unsigned long)late > wheeltest.late_max) {
+		wheeltest.late_max = late;
+	}
+	if ((unsigned long)arg == WHEELTEST_TIMERS) {
+		wheeltest.deleted++;
+	} else if (wheeltest.nr < (int)WHEELTEST_TIMERS) {
+		wheeltest.order[wheeltest.nr++] = (int)(unsigned long)arg;
+	}
+
+	return INT_NO_RESCHEDULE;
+}
+
+/*
+ * Timers added out of order, some of them cascaded down from a level
+ * above the root, expire in order of their delays, none early and none
+ * more than a tick late. A deleted timer does not expire.
+ */
+static int selftest_wheel(void)
+{
+	timer_t		 timers[WHEELTEST_TIMERS + 1];
+	unsigned long	 cascaded = timer_stats.cascaded;
+	int		 ok;
+	int		 i;
+
+	memset(&wheeltest, 0, sizeof(wheeltest));
+	for (i = 0; i <= (int)WHEELTEST_TIMERS; i++) {
+		init_timer_value(&timers[i]);
+	}
+
+	enter_critical_section();
+	for (i = 0; i < (int)WHEELTEST_TIMERS; i++) {
+		oneshot_timer_add(&timers[i], wheeltest_delays[i],
+				  (timer_function)wheeltest_function, (void *)(unsigned long)i);
+	}
+	oneshot_timer_add(&timers[i], WHEELTEST_DELETED,
+			  (timer_function)wheeltest_function, (void *)(unsigned long)i);
+	exit_critical_section();
+
+	timer_delete(&timers[WHEELTEST_TIMERS]);
+	task_sleep(wheeltest_delays[0] + 100);
+	for (i = 0; i <= (int)WHEELTEST_TIMERS; i++) {
+		timer_delete(&timers[i]);
+	}
+
+	ok = (WHEELTEST_TIMERS == wheeltest.nr) && (0 == wheeltest.early) && (0 == wheeltest.deleted) &&
+	     (wheeltest.late_max <= TICK_US / 1000) && (timer_stats.cascaded != cascaded);
+	for (i = 1; ok && (i < wheeltest.nr); i++) {
+		ok = wheeltest_delays[wheeltest.order[i - 1]] < wheeltest_delays[wheeltest.order[i]];
+	}
+
+	if (!ok) {
+		printk("%d of %d expired, %d early, deleted one %s, late max %d ms, %d cascaded, order:",
+		       wheeltest.nr, (int)WHEELTEST_TIMERS, wheeltest.early,
+		       wheeltest.deleted ? "expired" : "did not",
+		       (int)wheeltest.late_max, (int)(timer_stats.cascaded - cascaded));
+		for (i = 0; i < wheeltest.nr; i++) {
+			printk(" %d", (int)wheeltest_delays[wheeltest.order[i]]);
+		}
+		printk("\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+#define CLOCKTEST_READS		1000
+
+/*
+ * The ms, us and ns clocks never run backwards and never disagree:
+ * read coarse to fine, each later reading is at or past the one before.
+ */
+static int selftest_clock(void)
+{
+	unsigned long long	 ms, us, ns;
+	unsigned long long	 prev = 0;
+	int			 backwards = 0;
+	int			 behind = 0;
+	int			 i;
+
+	for (i = 0; i < CLOCKTEST_READS; i++) {
+		enter_critical_section();
+		ms = current_time();
+		us = current_time_hires();
+		ns = current_time_ns();
+		exit_critical_section();
+
+		if (ns < prev) {
+			backwards++;
+		}
+		if ((us / 1000 < ms) || (ns / NSEC_PER_USEC < us)) {
+			behind++;
+		}
+		prev = ns;
+	}
+
+	if (backwards || behind) {
+		printk("of %d reads, %d went backwards, %d were behind a coarser clock\n",
+		       CLOCKTEST_READS, backwards, behind);
+		return -1;
+	}
+
+	return 0;
+}
+
+#define SLEEPTEST_US		2500
+#define SLEEPTEST_MS		5
+
+/* sleeps last at least what was asked for and at most a tick more */
+static int selftest_sleep(void)
+{
+	unsigned long long	 start;
+	unsigned long		 us, ms;
+
+	start = current_time_hires();
+	task_usleep(SLEEPTEST_US);
+	us = (unsigned long)(current_time_hires() - start);
+
+	/* task_sleep() counts from the current ms, which has partly gone */
+	start = current_time_hires();
+	task_sleep(SLEEPTEST_MS);
+	ms = (unsigned long)(current_time_hires() - start);
+
+	if ((us < SLEEPTEST_US) || (us > SLEEPTEST_US + TICK_US) ||
+	    (ms < (SLEEPTEST_MS - 1) * 1000) || (ms > SLEEPTEST_MS * 1000 + TICK_US)) {
+		printk("task_usleep(%d) took %d us, task_sleep(%d) %d us\n",
+		       SLEEPTEST_US, (int)us, SLEEPTEST_MS, (int)ms);
+		return -1;
+	}
+
+	return 0;
+}
+
+#define TICKLESSTEST_MS		100
+
+/* the tick is stopped while we sleep and nothing else runs */
+static int selftest_tickless(void)
+{
+	#ifdef CONFIG_TICKLESS
+	unsigned long stopped = idle_stats.tickless;
+
+	if (!tickless_enabled) {
+		return SELFTEST_SKIP;
+	}
+
+	task_sleep(TICKLESSTEST_MS);
+	if (idle_stats.tickless == stopped) {
+		printk("idle for %d ms without stopping the tick\n", TICKLESSTEST_MS);
+		return -1;
+	}
+
+	return 0;
+	#else
+	return SELFTEST_SKIP;
+	#endif
+}
+
+/* co-expiring timers in one pass and a periodic one without drift */
+static int selftest_periodic(void)
+{
+	return timeracc_run(TIMERACC_DEFAULT);
+}
+
+#define SLACKTEST_DELAY		20	/* ms */
+#define SLACKTEST_SLACK		10
+
+static unsigned long slacktest_fired[2];
+
+static handler_return slacktest_function(timer_t *timer, unsigned long now, void *arg)
+{
+	slacktest_fired[(unsigned long)arg] = (unsigned long)current_time();
+
+	return INT_NO_RESCHEDULE;
+}
+
+/*
+ * A timer with slack, due shortly before one without, is moved later
+ * within its slack and not before; the one without is never moved.
+ */
+static int selftest_slack(void)
+{
+	timer_t		 exact, slack;
+	unsigned long	 moved;
+	int		 ok;
+
+	init_timer_value(&exact);
+	init_timer_value(&slack);
+	timer_set_slack(&slack, SLACKTEST_SLACK);
+	memset(slacktest_fired, 0, sizeof(slacktest_fired));
+
+	enter_critical_section();
+	oneshot_timer_add(&exact, SLACKTEST_DELAY, (timer_function)slacktest_function, (void *)0);
+	oneshot_timer_add(&slack, SLACKTEST_DELAY - SLACKTEST_SLACK / 2,
+			  (timer_function)slacktest_function, (void *)1);
+	exit_critical_section();
+
+	moved = slack.expired_time - slack.requested;
+	task_sleep(SLACKTEST_DELAY + SLACKTEST_SLACK + 10);
+	timer_delete(&exact);
+	timer_delete(&slack);
+
+	ok = (exact.expired_time == exact.requested) && (moved > 0) &&
+	     (moved <= SLACKTEST_SLACK) && slacktest_fired[0] && slacktest_fired[1] &&
+	     ((signed long)(slacktest_fired[1] - slack.requested) >= 0);
+	if (!ok) {
+		printk("exact moved by %d ms, slack by %d of %d ms, slack fired %d ms past its request\n",
+		       (int)(exact.expired_time - exact.requested), (int)moved,
+		       SLACKTEST_SLACK, (int)(slacktest_fired[1] - slack.requested));
+		return -1;
+	}
+
+	return 0;
+}
+
+static struct {
+	task_t	*task;
+	int	 in_interrupt;
+	int	 fired;
+} softtest;
+
+static handler_return softtest_function(timer_t *timer, unsigned long now, void *arg)
+{
+	softtest.task	      = current_task;
+	softtest.in_interrupt = in_interrupt();
+	softtest.fired++;
+
+	return INT_NO_RESCHEDULE;
+}
+
+/* a hard timer's function runs in the softirq, a soft one's in the timer task */
+static int selftest_soft(void)
+{
+	timer_t		 timer;
+	int		 ok = 1;
+	int		 soft;
+
+	for (soft = 0; soft < 2; soft++) {
+		init_timer_value(&timer);
+		timer_set_soft(&timer, soft);
+		memset(&softtest, 0, sizeof(softtest));
+
+		oneshot_timer_add(&timer, 5, (timer_function)softtest_function, NULL);
+		task_sleep(20);
+		timer_delete(&timer);
+
+		if (soft) {
+			ok = ok && (1 == softtest.fired) && !softtest.in_interrupt &&
+			     (NULL != softtest.task) && (0 == strcmp(softtest.task->name, "timer"));
+		} else {
+			ok = ok && (1 == softtest.fired) && softtest.in_interrupt;
+		}
+		if (!ok) {
+			printk("%s timer: fired %d times, %s, in %s\n", soft ? "soft" : "hard",
+			       softtest.fired, softtest.in_interrupt ? "in interrupt" : "in a task",
+			       softtest.task ? softtest.task->name : "-");
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static const struct selftest timer_tests[] = {
+	{ "wheel",	selftest_wheel },
+	{ "clock",	selftest_clock },
+	{ "sleep",	selftest_sleep },
+	{ "tickless",	selftest_tickless },
+	{ "periodic",	selftest_periodic },
+	{ "slack",	selftest_slack },
+	{ "soft",	selftest_soft },
+};
+
+SELFTEST_SET(timer_selftests, "timer", timer_tests);
+
+SHELL_COMMAND(timerbench_command, "timerbench", "help: timerbench [n], add, delete and expiry cost with n pending timers", CMD_FUNC_NAME(timerbench));
+SHELL_COMMAND(timeracc_command, "timeracc", "help: timeracc [n], expiry accuracy of n co-expiring timers and a periodic one", CMD_FUNC_NAME(timeracc));
+SHELL_COMMAND(timerstat_command, "timerstat", "help: timerstat [reset], timer wheel counters, slack and wakeups saved", CMD_FUNC_NAME(timerstat));
+SHELL_COMMAND(slackbench_command, "slackbench", "help: slackbench [slack], timer passes of 8 sleepers without and with slack", CMD_FUNC_NAME(slackbench));
+SHELL_COMMAND(softtimer_command, "softtimer", "help: softtimer [us], longest softirq with a busy timer run hard and soft", CMD_FUNC_NAME(softtimer));
+
+void register_timer_commands(void)
+{
+	shell_register_command(&timerbench_command);
+	shell_register_command(&timeracc_command);
+	shell_register_command(&timerstat_command);
+	shell_register_command(&slackbench_command);
+	shell_register_command(&softtimer_command);
+	selftest_register(&timer_selftests);
+}
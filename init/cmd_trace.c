@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include <kernel/types.h>
+#include <kernel/printk.h>
+#include <kernel/task.h>
+#include <kernel/semaphore.h>
+#include <kernel/trace.h>
+#include <init.h>
+
+#ifdef CONFIG_WAKEUP_TRACE
+static const char *trace_names[NR_TRACE_TYPES] = {
+	"wakeup", "switch", "irq enter", "irq exit", "cs enter", "cs exit",
+};
+
+/*
+ * wakeuptrace                 worst wakeup latency and the events before it
+ * wakeuptrace reset           forget the worst case and the event ring
+ * wakeuptrace on|off          start or stop recording
+ * wakeuptrace prio <prio>     trace tasks at this priority or above
+ */
+CMD_FUNC(wakeuptrace) {
+	static struct wakeup_trace	 snap;
+	struct trace_event		*e;
+	unsigned long long		 base;
+	char				*arg;
+	int				 i;
+
+	if (args && (0 == strncmp(args, "reset", 5))) {
+		wakeup_trace_reset();
+		return 0;
+	}
+
+	if (args && (0 == strncmp(args, "on", 2))) {
+		wakeup_trace_enabled = 1;
+		return 0;
+	}
+
+	if (args && (0 == strncmp(args, "off", 3))) {
+		wakeup_trace_enabled = 0;
+		return 0;
+	}
+
+	if (args && (0 == strncmp(args, "prio", 4))) {
+		arg		  = shell_next_arg(args);
+		wakeup_trace_prio = simple_strtoul(arg, NULL, 10);
+		return 0;
+	}
+
+	enter_critical_section();
+	memcpy(&snap, &wakeup_trace_max, sizeof(snap));
+	exit_critical_section();
+
+	printk("tracer:  %s, priorities 0..%d\n", wakeup_trace_enabled ? "on" : "off",
+	       wakeup_trace_prio);
+	if (0 == snap.nr_events) {
+		printk("no wakeup traced yet\n");
+		return 0;
+	}
+
+	printk("worst:   %d ns, pid %d (%s) prio %d\n", (int)snap.latency,
+	       snap.pid, snap.name, snap.priority);
+
+	/* times are relative to the wakeup of the worst case */
+	base = snap.events[snap.nr_events - 1].time;
+	for (i = snap.nr_events - 1; i >= 0; i--) {
+		e = &snap.events[i];
+		if ((TRACE_WAKEUP == e->type) && (snap.pid == (int)e->arg)) {
+			base = e->time;
+			break;
+		}
+	}
+
+	printk(" time/ns  pid  event\n");
+	for (i = 0; i < snap.nr_events; i++) {
+		e = &snap.events[i];
+		printk("%8d %4d  %-10s", (int)(long)(e->time - base), e->pid, trace_names[e->type]);
+		switch (e->type) {
+		case TRACE_WAKEUP:
+		case TRACE_SWITCH:
+			printk(" pid %d\n", (int)e->arg);
+			break;
+		case TRACE_IRQ_EXIT:
+			printk(" ret %d\n", (int)e->arg);
+			break;
+		case TRACE_CS_ENTER:
+		case TRACE_CS_EXIT:
+			printk(" pc 0x%x\n", e->arg);
+			break;
+		default:
+			printk("\n");
+			break;
+		}
+	}
+
+	return 0;
+}
+
+SHELL_COMMAND(wakeuptrace_command, "wakeuptrace", "help: wakeuptrace [reset|on|off|prio <prio>], worst wakeup latency and its events, off by default", CMD_FUNC_NAME(wakeuptrace));
+
+static int tracetest_waiter(void *arg)
+{
+	down((struct semaphore *)arg);
+	return 0;
+}
+
+/* wake a task above us once, nonzero if it could not be started */
+static int tracetest_wake(void)
+{
+	struct semaphore	 sem;
+	task_t			*task;
+
+	sema_init(&sem, 0);
+	task = selftest_task("trace", current_task->priority - 1, tracetest_waiter, &sem);
+	if (NULL == task) {
+		return -1;
+	}
+
+	/* let it run into down() */
+	enter_critical_section();
+	task_schedule();
+	exit_critical_section();
+
+	up(&sem);
+	task_join(task, NULL);
+
+	return 0;
+}
+#endif
+
+/* the tracer records nothing while it is off, and a wakeup once it is on */
+static int selftest_trace(void)
+{
+	#ifdef CONFIG_WAKEUP_TRACE
+	int		 enabled = wakeup_trace_enabled;
+	unsigned int	 prio	 = wakeup_trace_prio;
+	int		 off, on;
+	int		 err;
+
+	wakeup_trace_prio = current_task->priority - 1;
+
+	wakeup_trace_enabled = 0;
+	wakeup_trace_reset();
+	err = tracetest_wake();
+	off = wakeup_trace_max.nr_events;
+
+	wakeup_trace_enabled = 1;
+	wakeup_trace_reset();
+	err = err || tracetest_wake();
+	on  = wakeup_trace_max.nr_events;
+
+	wakeup_trace_enabled = enabled;
+	wakeup_trace_prio    = prio;
+
+	if (err || off || !on) {
+		printk("events traced with the tracer off: %d, on: %d\n", off, on);
+		return -1;
+	}
+
+	return 0;
+	#else
+	return SELFTEST_SKIP;
+	#endif
+}
+
+static const struct selftest trace_tests[] = {
+	{ "trace",	selftest_trace },
+};
+
+SELFTEST_SET(trace_selftests, "sched", trace_tests);
+
+void register_trace_commands(void)
+{
+	#ifdef CONFIG_WAKEUP_TRACE
+	shell_register_command(&wakeuptrace_command);
+	#endif
+	selftest_register(&trace_selftests);
+}
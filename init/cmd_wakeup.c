@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include <kernel/types.h>
+#include <kernel/printk.h>
+#include <kernel/task.h>
+#include <kernel/wait_queue.h>
+#include <init.h>
+
+static int wake_sizes[] = { 1, 8, 32 };
+
+struct wakebench {
+	wait_queue_head_t	wq;
+	int			go;
+	unsigned long long	end;
+};
+
+static int wake_waiter(void *arg)
+{
+	struct wakebench *wb = arg;
+	DECLARE_WAITQUEUE(wait, current_task);
+
+	add_wait_queue(&wb->wq, &wait);
+	set_current_state(SLEEPING);
+	if (!wb->go) {
+		schedule_timeout(MAX_SCHEDULE_TIMEOUT);
+	}
+	finish_wait(&wb->wq, &wait);
+
+	/* the last one to run marks the end of the broadcast */
+	wb->end = current_time_ns();
+
+	return 0;
+}
+
+/*
+ * Block nr tasks on a wait queue at a higher priority than the caller
+ * and wake them all at once. Returns the time until the last one ran in
+ * nanoseconds and the number of times the waker was switched out, or -1.
+ */
+static long wakebench_run(int nr, task_t **tasks, unsigned long *switches)
+{
+	struct wakebench	 wb;
+	unsigned long long	 start;
+	unsigned long		 nivcsw;
+	unsigned int		 prio = current_task->priority;
+	int			 created = 0;
+	int			 i;
+
+	if (prio > 0) {
+		prio--;
+	}
+
+	init_waitqueue_head(&wb.wq);
+	wb.go  = 0;
+	wb.end = 0;
+
+	for (i = 0; i < nr; i++) {
+		tasks[i] = task_alloc("wake", BENCH_STACK_SIZE, prio);
+		if (NULL == tasks[i]) {
+			break;
+		}
+		if (task_create(tasks[i], wake_waiter, &wb)) {
+			task_free(tasks[i]);
+			break;
+		}
+		created++;
+	}
+
+	/* let them go to sleep on the queue */
+	enter_critical_section();
+	task_schedule();
+	exit_critical_section();
+
+	nivcsw = current_task->nivcsw;
+	start  = current_time_ns();
+	wb.go  = 1;
+	wake_up_all(&wb.wq);
+	*switches = current_task->nivcsw - nivcsw;
+
+	for (i = 0; i < created; i++) {
+		task_join(tasks[i], NULL);
+	}
+
+	if (created != nr) {
+		printk("wakebench: only %d of %d tasks created\n", created, nr);
+		return -1;
+	}
+
+	return (long)(wb.end - start);
+}
+
+CMD_FUNC(wakebench) {
+	task_t		*tasks[32];
+	unsigned long	 switches;
+	long		 cost;
+	int		 i;
+
+	printk("waiters    broadcast (ns)    waker switched out\n");
+	for (i = 0; i < (int)(sizeof(wake_sizes) / sizeof(wake_sizes[0])); i++) {
+		cost = wakebench_run(wake_sizes[i], tasks, &switches);
+		if (cost < 0) {
+			return -1;
+		}
+		printk("%7d    %14d    %18d\n", wake_sizes[i], (int)cost, (int)switches);
+	}
+
+	return 0;
+}
+
+#define WAKETEST_WAITERS	8
+
+/* a broadcast to several waiters switches the waker out once at most */
+static int selftest_wakeall(void)
+{
+	task_t		*tasks[WAKETEST_WAITERS];
+	unsigned long	 switches;
+
+	if (wakebench_run(WAKETEST_WAITERS, tasks, &switches) < 0) {
+		return -1;
+	}
+
+	if (switches > 1) {
+		printk("waking %d waiters switched the waker out %d times\n",
+		       WAKETEST_WAITERS, (int)switches);
+		return -1;
+	}
+
+	return 0;
+}
+
+static const struct selftest wakeup_tests[] = {
+	{ "wakeall",	selftest_wakeall },
+};
+
+SELFTEST_SET(wakeup_selftests, "sched", wakeup_tests);
+
+SHELL_COMMAND(wakebench_command, "wakebench", "help: broadcast wakeup of 1, 8 and 32 waiters, time and waker switches", CMD_FUNC_NAME(wakebench));
+
+void register_wakeup_commands(void)
+{
+	shell_register_command(&wakebench_command);
+	selftest_register(&wakeup_selftests);
+}
@@ -465,6 +465,30 @@ void shell_register_command(struct shell_command *cmd)
 	}
 }
 
+/* the word after the one at args, skipping blanks */
+char *shell_next_arg(char *args)
+{
+	while (*args && (*args != ' ')) {
+		args++;
+	}
+	while (*args == ' ') {
+		args++;
+	}
+
+	return args;
+}
+
+/* copy the word at args into buf, which holds size bytes */
+void shell_copy_arg(char *buf, int size, const char *args)
+{
+	int i;
+
+	for (i = 0; (i < size - 1) && args[i] && (args[i] != ' '); i++) {
+		buf[i] = args[i];
+	}
+	buf[i] = '\0';
+}
+
 int run_command(const char *cmd)
 {
 	char			 cmdbuf[CONSOLE_BUFFER_SIZE];
@@ -520,6 +544,22 @@ int init_shell(void *arg)
 	shell_register_command(&ls_command);
 	shell_register_command(&cd_command);
 	shell_register_command(&help_command);
+	register_sched_commands();
+	register_rr_commands();
+	register_edf_commands();
+	register_mutex_commands();
+	register_switch_commands();
+	register_wakeup_commands();
+	register_trace_commands();
+	register_cyclic_commands();
+	register_periodic_commands();
+	register_tgroup_commands();
+	register_task_commands();
+	register_timer_commands();
+	register_irq_commands();
+	register_ipc_commands();
+	register_pt_commands();
+	register_selftest_commands();
 
 	for (;;) {
 		printk("%s # ", vfs_get_cur_path());
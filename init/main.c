@@ -28,6 +28,8 @@
 #include <kernel/types.h>
 #include <kernel/timer.h>
 #include <kernel/semaphore.h>
+#include <kernel/pt.h>
+#include <kernel/irq.h>
 #include <init.h>
 #include <fs/vfsfs.h>
 #include <fs/vfsfat.h>
@@ -59,12 +61,13 @@ void kmain(void)
 
 	/*************** Init Platform ****************/
 	platform_init();
+	softirq_init();
 	timer_init();
 	buses_init();
 
 	/*************** Init Task ****************/
 	task_init();
-	task_create_init();
+	pt_init();
 
 	/*************** Init Workqueu ****************/
 	init_workqueues();
@@ -73,7 +76,7 @@ void kmain(void)
 	register_filesystem(&fat_fs);
 	
 	/*************** Creating Shell TASK ****************/
-	task_shell = task_alloc("shell", 0x2000, 5);
+	task_shell = task_alloc("shell", 0x2000, SHELL_PRIORITY);
 	if (NULL == task_shell)
 	{
 		return;
@@ -82,6 +85,8 @@ void kmain(void)
 	ret = task_create(task_shell, init_shell, 0);
 	if (ret) {
 		printk("Create init shell task failed\n");
+	} else {
+		task_detach(task_shell);
 	}
 
 	sema_init(&sem, 1);
@@ -91,7 +96,7 @@ void kmain(void)
 	while(1)
 	{
 		enter_critical_section();
-		arch_idle();
+		timer_idle();
 		task_schedule();
 		exit_critical_section();
 	}
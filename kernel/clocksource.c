@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <kernel/types.h>
+#include <kernel/task.h>
+#include <kernel/timer.h>
+#include <kernel/seqlock.h>
+#include <kernel/clocksource.h>
+
+/*
+ * The clock as of the last clocksource_update(): the counter value and
+ * the time in ns, us and ms, each whole with the rest carried over, so
+ * that nothing is lost to rounding from one update to the next. Readers
+ * add what the counter has run since, the us and ms clocks with a
+ * 32-bit division by a constant while that is less than ~4s, which the
+ * tick and max_idle_ms see to.
+ */
+struct clock_base {
+	unsigned long		 cycle_last;
+	unsigned long		 frac;		/* ns << shift short of a whole ns */
+	unsigned long long	 ns;
+	unsigned long long	 us;
+	unsigned long		 us_rem;	/* ns short of a whole us */
+	unsigned long long	 ms;
+	unsigned long		 ms_rem;	/* ns short of a whole ms */
+};
+
+static struct clocksource	*clock;
+static struct clock_base	 clock_base;
+static seqcount_t		 clock_seq = SEQCNT_ZERO;
+
+/* counts from the last update to cycles in ns, the rest of a ns in *frac */
+static __always_inline unsigned long long clock_delta(unsigned long cycles, unsigned long *frac)
+{
+	unsigned long		 delta;
+	unsigned long long	 ns;
+
+	delta = (cycles - clock_base.cycle_last) & clock->mask;
+	ns    = (unsigned long long)delta * clock->mult + clock_base.frac;
+	if (frac)
+	{
+		*frac = (unsigned long)(ns & ((1ULL << clock->shift) - 1));
+	}
+
+	return ns >> clock->shift;
+}
+
+/* whole units in base plus rem + ns, mostly without a 64-bit division */
+static __always_inline unsigned long long clock_units(unsigned long long base, unsigned long rem,
+						      unsigned long long ns, unsigned long unit)
+{
+	ns += rem;
+	if (likely(ns <= ~0UL))
+	{
+		return base + (unsigned long)ns / unit;
+	}
+
+	return base + ns / unit;
+}
+
+/* add ns to a whole + remainder pair */
+static void clock_carry(unsigned long long *whole, unsigned long *rem,
+			unsigned long long ns, unsigned long unit)
+{
+	ns += *rem;
+	if (likely(ns <= ~0UL))
+	{
+		*whole += (unsigned long)ns / unit;
+		*rem	= (unsigned long)ns % unit;
+		return;
+	}
+
+	*whole += ns / unit;
+	*rem	= (unsigned long)(ns % unit);
+}
+
+void clocksource_register(struct clocksource *cs)
+{
+	unsigned long long	 mult;
+	unsigned long long	 ns;
+	unsigned int		 shift;
+
+	/* the most precise mult that keeps cycles * mult in 64 bits */
+	for (shift = 32; shift > 0; shift--)
+	{
+		mult = ((unsigned long long)NSEC_PER_SEC << shift) / cs->freq;
+		if (mult <= ~0UL)
+		{
+			break;
+		}
+	}
+	cs->mult  = (unsigned long)mult;
+	cs->shift = shift;
+
+	/* half a wrap of the counter, and the readers' divisions stay 32-bit */
+	ns = ((unsigned long long)(cs->mask >> 1) * cs->mult) >> cs->shift;
+	if (ns > ~0UL - NSEC_PER_MSEC)
+	{
+		ns = ~0UL - NSEC_PER_MSEC;
+	}
+	cs->max_idle_ms = (unsigned long)(ns / NSEC_PER_MSEC);
+
+	enter_critical_section();
+	write_seqcount_begin(&clock_seq);
+	clock_base.cycle_last = cs->read();
+	clock_base.frac	      = 0;
+	clock		      = cs;
+	write_seqcount_end(&clock_seq);
+	exit_critical_section();
+}
+
+/*
+ * Fold the counter into the base, at least once per max_idle_ms. From
+ * the tick, with interrupts masked.
+ */
+void clocksource_update(void)
+{
+	unsigned long long	 ns;
+	unsigned long		 frac;
+	unsigned long		 now;
+
+	if (NULL == clock)
+	{
+		return;
+	}
+
+	now = clock->read();
+	ns  = clock_delta(now, &frac);
+
+	write_seqcount_begin(&clock_seq);
+	clock_base.cycle_last = now;
+	clock_base.frac	      = frac;
+	clock_base.ns	     += ns;
+	clock_carry(&clock_base.us, &clock_base.us_rem, ns, NSEC_PER_USEC);
+	clock_carry(&clock_base.ms, &clock_base.ms_rem, ns, NSEC_PER_MSEC);
+	write_seqcount_end(&clock_seq);
+}
+
+/* longest the tick may stay stopped, 0 if there is no clocksource yet */
+unsigned long clocksource_max_idle_ms(void)
+{
+	return clock ? clock->max_idle_ms : 0;
+}
+
+/* nanoseconds since the clocksource was registered */
+unsigned long long current_time_ns(void)
+{
+	unsigned long long	 ns;
+	unsigned int		 seq;
+
+	if (NULL == clock)
+	{
+		return 0;
+	}
+
+	do {
+		seq = read_seqcount_begin(&clock_seq);
+		ns  = clock_base.ns + clock_delta(clock->read(), NULL);
+	} while (read_seqcount_retry(&clock_seq, seq));
+
+	return ns;
+}
+
+/* microseconds, for accounting: no 64-bit division and no critical section */
+unsigned long long current_time_hires(void)
+{
+	unsigned long long	 us;
+	unsigned int		 seq;
+
+	if (NULL == clock)
+	{
+		return 0;
+	}
+
+	do {
+		seq = read_seqcount_begin(&clock_seq);
+		us  = clock_units(clock_base.us, clock_base.us_rem,
+				  clock_delta(clock->read(), NULL), NSEC_PER_USEC);
+	} while (read_seqcount_retry(&clock_seq, seq));
+
+	return us;
+}
+
+/* milliseconds, the timers' clock */
+unsigned long long current_time(void)
+{
+	unsigned long long	 ms;
+	unsigned int		 seq;
+
+	if (NULL == clock)
+	{
+		return 0;
+	}
+
+	do {
+		seq = read_seqcount_begin(&clock_seq);
+		ms  = clock_units(clock_base.ms, clock_base.ms_rem,
+				  clock_delta(clock->read(), NULL), NSEC_PER_MSEC);
+	} while (read_seqcount_retry(&clock_seq, seq));
+
+	return ms;
+}
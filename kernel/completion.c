@@ -38,9 +38,9 @@ static inline long
 __wait_for_common(struct completion *x,
 		  long (*action)(long), long timeout, int state)
 {
-	down(&x->wait.lock);
+	mutex_lock(&x->wait.lock);
 	timeout = do_wait_for_common(x, action, timeout, state);
-	up(&x->wait.lock);
+	mutex_unlock(&x->wait.lock);
 	return timeout;
 }
 
@@ -65,10 +65,10 @@ bool completion_done(struct completion *x)
 {
 	int ret = 1;
 
-	down(&x->wait.lock);
+	mutex_lock(&x->wait.lock);
 	if (!x->done)
 		ret = 0;
-	up(&x->wait.lock);
+	mutex_unlock(&x->wait.lock);
 	return ret;
 }
 
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <kernel/types.h>
+#include <kernel/task.h>
+#include <kernel/sched.h>
+#include <kernel/ipc.h>
+#include <compiler.h>
+
+/*
+ * Synchronous IPC. A client blocks in ipc_call() until the server has
+ * replied; the server answers one call and waits for the next one in
+ * ipc_reply_wait(). When the other side is already waiting the cpu is
+ * handed straight to it with task_switch_to(), and with round-robin
+ * the server runs on what is left of the client's slice, which goes
+ * back to the client with the reply.
+ */
+struct ipc_caller {
+	struct list_head	 list;
+	task_t			*task;
+};
+
+static inline void ipc_lend_slice(task_t *from, task_t *to)
+{
+	#ifdef CONFIG_SCHED_RR
+	to->time_left = from->time_left;
+	#endif
+}
+
+/* block until woken up with cond cleared, called in a critical section */
+#define ipc_block_while(cond)				\
+	do {						\
+		while (cond) {				\
+			set_task_state(current_task, BLOCKED);	\
+			sched_dequeue_task(current_task, 0);	\
+			task_schedule();		\
+		}					\
+	} while (0)
+
+/* hand the cpu to a task blocked in ipc, the current one blocks */
+static void ipc_handoff(task_t *next)
+{
+	set_task_state(current_task, BLOCKED);
+	sched_dequeue_task(current_task, 0);
+
+	set_task_state(next, READY);
+	sched_enqueue_task(next, ENQUEUE_WAKEUP);
+	ipc_lend_slice(current_task, next);
+
+	task_switch_to(next);
+}
+
+/* copy the reply and let the caller go, called in a critical section */
+static void ipc_do_reply(task_t *caller, struct ipc_msg *msg)
+{
+	*caller->ipc_msg = *msg;
+	caller->ipc_msg	 = NULL;
+}
+
+/*
+ * Send msg to the server of ep and wait for the reply, which is copied
+ * back into msg.
+ */
+void ipc_call(struct ipc_endpoint *ep, struct ipc_msg *msg)
+{
+	struct ipc_caller	 caller;
+	task_t			*server;
+
+	enter_critical_section();
+
+	current_task->ipc_msg = msg;
+
+	server = ep->server;
+	if (NULL != server) {
+		ep->server	    = NULL;
+		*server->ipc_msg    = *msg;
+		server->ipc_partner = current_task;
+		ipc_handoff(server);
+	}
+	else {
+		caller.task = current_task;
+		list_add_tail(&caller.list, &ep->callers);
+	}
+
+	ipc_block_while(NULL != current_task->ipc_msg);
+
+	exit_critical_section();
+}
+
+/* reply to caller without waiting for another call */
+void ipc_reply(task_t *caller, struct ipc_msg *msg)
+{
+	enter_critical_section();
+
+	if ((NULL != caller) && (NULL != caller->ipc_msg)) {
+		ipc_do_reply(caller, msg);
+		set_task_state(caller, READY);
+		sched_enqueue_task(caller, ENQUEUE_WAKEUP);
+		sched_check_preempt(caller);
+	}
+
+	exit_critical_section();
+}
+
+/*
+ * Reply to caller (NULL the first time round) with msg, then wait for
+ * the next call on ep. Returns the task that called, its message is in
+ * msg; it is the caller to pass back with the reply. An endpoint has one
+ * server: NULL if another task is already waiting on ep, nothing is
+ * replied then.
+ */
+task_t *ipc_reply_wait(struct ipc_endpoint *ep, task_t *caller, struct ipc_msg *msg)
+{
+	struct ipc_caller	*next;
+	task_t			*reply_to = NULL;
+
+	enter_critical_section();
+
+	if ((NULL != ep->server) && (current_task != ep->server)) {
+		exit_critical_section();
+		return NULL;
+	}
+
+	if ((NULL != caller) && (NULL != caller->ipc_msg)) {
+		ipc_do_reply(caller, msg);
+		reply_to = caller;
+	}
+
+	/* a call is waiting already, take it and let the old caller go */
+	if (!list_empty(&ep->callers)) {
+		next = list_first_entry(&ep->callers, struct ipc_caller, list);
+		list_del(&next->list);
+		*msg = *next->task->ipc_msg;
+
+		if (NULL != reply_to) {
+			set_task_state(reply_to, READY);
+			sched_enqueue_task(reply_to, ENQUEUE_WAKEUP);
+			sched_check_preempt(reply_to);
+		}
+
+		exit_critical_section();
+		return next->task;
+	}
+
+	ep->server		  = current_task;
+	current_task->ipc_msg	  = msg;
+	current_task->ipc_partner = NULL;
+
+	if (NULL != reply_to) {
+		ipc_handoff(reply_to);
+	}
+
+	ipc_block_while(ep->server == current_task);
+
+	reply_to = current_task->ipc_partner;
+	exit_critical_section();
+
+	return reply_to;
+}
@@ -0,0 +1,312 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include <kernel/irq.h>
+#include <kernel/task.h>
+#include <kernel/timer.h>
+#include <kernel/trace.h>
+#include <kernel/printk.h>
+#include <mm/malloc.h>
+
+//#define DEBUG    1
+#include <kernel/debug.h>
+
+/* how often do_softirq() goes round before leaving the rest for later */
+#define MAX_SOFTIRQ_RESTART	10
+
+struct irq_stats		 irq_stats;
+LIST_HEAD(irq_actions);
+
+static softirq_action		 softirq_vec[NR_SOFTIRQS];
+static volatile unsigned long	 softirq_pending;
+static int			 softirq_running;
+static int			 hardirq_nesting;
+static unsigned long long	 hardirq_start;
+
+static struct tasklet_struct	*tasklet_head;
+static struct tasklet_struct   **tasklet_tail = &tasklet_head;
+
+int in_interrupt(void)
+{
+	return hardirq_nesting || softirq_running;
+}
+
+void open_softirq(int nr, softirq_action action)
+{
+	softirq_vec[nr] = action;
+}
+
+/*
+ * Mark a softirq pending. Raised from interrupt context it runs on
+ * interrupt exit; raised from a task outside any critical section it
+ * runs right away.
+ */
+void raise_softirq(int nr)
+{
+	int now = (0 == critical_section_count) && !softirq_running;
+
+	enter_critical_section();
+	softirq_pending |= 1UL << nr;
+	if (now)
+	{
+		do_softirq();
+	}
+	exit_critical_section();
+}
+
+/*
+ * Run pending softirqs with interrupts enabled. Called with the outermost
+ * critical section held (interrupt exit, the idle loop) and returns with
+ * it held again. A softirq that returns INT_RESCHEDULE sets need_resched.
+ */
+void do_softirq(void)
+{
+	int			 saved	 = critical_section_count;
+	int			 restart = MAX_SOFTIRQ_RESTART;
+	unsigned long		 pending;
+	unsigned long long	 start;
+	unsigned long		 elapsed;
+	int			 nr;
+
+	if (softirq_running || !softirq_pending)
+	{
+		return;
+	}
+
+	softirq_running	      = 1;
+	critical_section_count = 0;
+	arch_enable_ints();
+
+	do
+	{
+		enter_critical_section();
+		pending		= softirq_pending;
+		softirq_pending = 0;
+		exit_critical_section();
+
+		for (nr = 0; pending; nr++, pending >>= 1)
+		{
+			if (!(pending & 1) || (NULL == softirq_vec[nr]))
+			{
+				continue;
+			}
+
+			start = current_time_hires();
+			if (INT_NO_RESCHEDULE != softirq_vec[nr]())
+			{
+				need_resched = 1;
+			}
+			elapsed = (unsigned long)(current_time_hires() - start);
+
+			irq_stats.softirqs[nr]++;
+			if (elapsed > irq_stats.softirq_max)
+			{
+				irq_stats.softirq_max = elapsed;
+			}
+		}
+	} while (softirq_pending && --restart);
+
+	arch_disable_ints();
+	critical_section_count = saved;
+	softirq_running	      = 0;
+}
+
+/* called by the arch interrupt entry before the handlers run */
+void irq_enter(void)
+{
+	hardirq_nesting++;
+	hardirq_start = current_time_hires();
+	trace_event(TRACE_IRQ_ENTER, 0);
+}
+
+/*
+ * Called by the arch interrupt entry after the handlers ran, with what
+ * they returned. Runs softirqs, an interrupt that came in during
+ * softirqs leaves them to the one it interrupted. The switch itself is
+ * done by the arch code on the way out when need_resched is set.
+ */
+void irq_exit(handler_return ret)
+{
+	unsigned long elapsed = (unsigned long)(current_time_hires() - hardirq_start);
+
+	irq_stats.hardirqs++;
+	if (elapsed > irq_stats.hardirq_max)
+	{
+		irq_stats.hardirq_max = elapsed;
+	}
+
+	trace_event(TRACE_IRQ_EXIT, ret);
+	hardirq_nesting--;
+
+	if (INT_NO_RESCHEDULE != ret)
+	{
+		need_resched = 1;
+	}
+
+	do_softirq();
+}
+
+void tasklet_schedule(struct tasklet_struct *t)
+{
+	enter_critical_section();
+	if (!(t->state & TASKLET_STATE_SCHED))
+	{
+		t->state     |= TASKLET_STATE_SCHED;
+		t->next	      = NULL;
+		*tasklet_tail = t;
+		tasklet_tail  = &t->next;
+	}
+	exit_critical_section();
+
+	raise_softirq(TASKLET_SOFTIRQ);
+}
+
+static handler_return tasklet_action(void)
+{
+	struct tasklet_struct	*list;
+	struct tasklet_struct	*t;
+
+	enter_critical_section();
+	list	     = tasklet_head;
+	tasklet_head = NULL;
+	tasklet_tail = &tasklet_head;
+	exit_critical_section();
+
+	while (list)
+	{
+		t    = list;
+		list = list->next;
+
+		/* may be scheduled again from its own func */
+		t->state &= ~TASKLET_STATE_SCHED;
+		t->func(t->data);
+	}
+
+	return INT_NO_RESCHEDULE;
+}
+
+/* top half: wake the irq task */
+static handler_return irq_thread_top(void *arg)
+{
+	struct irq_action	*action = arg;
+	handler_return		 ret	= INT_WAKE_THREAD;
+
+	action->count++;
+
+	if (action->handler)
+	{
+		ret = action->handler(action->arg);
+	}
+	else
+	{
+		/* nothing acks the device before the thread runs, keep it quiet */
+		mask_interrupt(action->vector);
+	}
+
+	if (INT_WAKE_THREAD == ret)
+	{
+		/* flags need_resched if the thread should run first */
+		up(&action->wakeup);
+		return INT_NO_RESCHEDULE;
+	}
+
+	return ret;
+}
+
+static int irq_thread(void *arg)
+{
+	struct irq_action *action = arg;
+
+	while (1)
+	{
+		down(&action->wakeup);
+
+		action->thread_count++;
+		action->thread_fn(action->arg);
+
+		if (action->oneshot)
+		{
+			unmask_interrupt(action->vector);
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Install a split interrupt handler. handler runs in interrupt context,
+ * acks the device and returns INT_WAKE_THREAD to have thread_fn run in
+ * a task of its own at priority. Without a handler the vector is masked
+ * until thread_fn is done.
+ */
+int request_threaded_irq(unsigned int vector, int_handler handler,
+			 int_handler thread_fn, void *arg,
+			 unsigned int priority, char *name)
+{
+	struct irq_action *action;
+
+	if (NULL == thread_fn)
+	{
+		register_int_handler(vector, handler, arg);
+		unmask_interrupt(vector);
+		return 0;
+	}
+
+	action = (struct irq_action *)kmalloc(sizeof(*action));
+	if (NULL == action)
+	{
+		return -1;
+	}
+
+	memset(action, 0, sizeof(*action));
+	action->vector	  = vector;
+	action->handler	  = handler;
+	action->thread_fn = thread_fn;
+	action->arg	  = arg;
+	action->oneshot	  = (NULL == handler);
+	sema_init(&action->wakeup, 0);
+
+	action->task = task_alloc(name, 0x800, priority);
+	if ((NULL == action->task) ||
+	    task_create(action->task, irq_thread, action))
+	{
+		task_free(action->task);
+		kfree(action);
+		return -1;
+	}
+	task_detach(action->task);
+
+	enter_critical_section();
+	list_add_tail(&action->list, &irq_actions);
+	exit_critical_section();
+
+	register_int_handler(vector, irq_thread_top, action);
+	unmask_interrupt(vector);
+
+	return 0;
+}
+
+void softirq_init(void)
+{
+	open_softirq(TASKLET_SOFTIRQ, tasklet_action);
+}
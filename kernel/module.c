@@ -23,7 +23,7 @@
 #include <kernel/types.h>
 #include <mm/malloc.h>
 #include <kernel/list.h>
-#include <kernel/semaphore.h>
+#include <kernel/mutex.h>
 #include <kernel/printk.h>
 #include <module/module.h>
 #include <module/module_arch.h>
@@ -62,7 +62,7 @@ struct elf_operations {
 
 char module_unknown[30];
 LIST_HEAD(k_module_root);
-DEFINE_SEMAPHORE(kmod_sem);
+DEFINE_MUTEX(kmod_lock);
 
 static const unsigned char elf_magic_header[] =
 {
@@ -723,9 +723,9 @@ struct k_module *alloc_kmodule(void)
 	memset(mod, 0, sizeof(struct k_module));
 	mod->ops = &mod_output_ops;
 
-	down(&kmod_sem);
+	mutex_lock(&kmod_lock);
 	list_add_tail(&mod->list, &k_module_root);
-	up(&kmod_sem);
+	mutex_unlock(&kmod_lock);
 
 	return mod;
 }
@@ -736,9 +736,9 @@ void free_kmodule(struct k_module *kmod)
 		return;
 	}
 	
-	down(&kmod_sem);
+	mutex_lock(&kmod_lock);
 	list_del(&kmod->list);
-	up(&kmod_sem);
+	mutex_unlock(&kmod_lock);
 
 	/* Free text segment */
 	module_output_free_segment(kmod, MODULE_SEG_TEXT);
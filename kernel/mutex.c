@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <kernel/types.h>
+#include <kernel/task.h>
+#include <kernel/sched.h>
+#include <kernel/mutex.h>
+#include <compiler.h>
+
+struct mutex_waiter {
+	struct list_head	 list;
+	task_t			*task;
+};
+
+extern task_t	*current_task;
+
+static void mutex_enqueue_waiter(struct mutex *lock, struct mutex_waiter *waiter)
+{
+	struct mutex_waiter	*iterator;
+	unsigned int		 prio = task_wait_priority(waiter->task);
+
+	/* highest priority first, fifo among equals */
+	list_for_each_entry(iterator, &lock->wait_list, list) {
+		if (prio < task_wait_priority(iterator->task)) {
+			break;
+		}
+	}
+	list_add_tail(&waiter->list, &iterator->list);
+}
+
+static void mutex_set_owner(struct mutex *lock, task_t *task)
+{
+	lock->locked = 1;
+	lock->owner  = task;
+
+	/* nobody to track ownership for before the first task exists */
+	if (NULL != task) {
+		list_add(&lock->held, &task->held_mutexes);
+	}
+}
+
+/* a task runs at its own priority or that of the top waiter it blocks */
+static unsigned int mutex_inherited_priority(task_t *task)
+{
+	struct mutex		*lock;
+	struct mutex_waiter	*top;
+	unsigned int		 prio = task->base_priority;
+
+	list_for_each_entry(lock, &task->held_mutexes, held) {
+		if (list_empty(&lock->wait_list)) {
+			continue;
+		}
+
+		top = list_first_entry(&lock->wait_list, struct mutex_waiter, list);
+		if (task_wait_priority(top->task) < prio) {
+			prio = task_wait_priority(top->task);
+		}
+	}
+
+	return prio;
+}
+
+/*
+ * Recompute the priority of task and, while it keeps changing, of the
+ * owners further down the chain of mutexes task is blocked on.
+ */
+static void mutex_adjust_chain(task_t *task)
+{
+	struct mutex	*lock;
+	unsigned int	 prio;
+
+	while (NULL != task) {
+		prio = mutex_inherited_priority(task);
+		if (prio == task->priority) {
+			break;
+		}
+
+		sched_set_priority(task, prio);
+
+		lock = task->blocked_on;
+		if (NULL == lock) {
+			break;
+		}
+
+		/* keep the wait list ordered with the new priority */
+		list_del(&task->mutex_waiter->list);
+		mutex_enqueue_waiter(lock, task->mutex_waiter);
+
+		task = lock->owner;
+	}
+}
+
+void mutex_lock(struct mutex *lock)
+{
+	task_t			*task = current_task;
+	struct mutex_waiter	 waiter;
+
+	enter_critical_section();
+
+	if (likely(!lock->locked)) {
+		mutex_set_owner(lock, task);
+		exit_critical_section();
+		return;
+	}
+
+	waiter.task	   = task;
+	mutex_enqueue_waiter(lock, &waiter);
+	task->blocked_on   = lock;
+	task->mutex_waiter = &waiter;
+
+	mutex_adjust_chain(lock->owner);
+
+	/* mutex_unlock() hands the lock over before waking us */
+	while (lock->owner != task) {
+		set_task_state(task, BLOCKED);
+		sched_dequeue_task(task, 0);
+		task_schedule();
+	}
+
+	exit_critical_section();
+}
+
+int mutex_trylock(struct mutex *lock)
+{
+	int ret = 0;
+
+	enter_critical_section();
+	if (!lock->locked) {
+		mutex_set_owner(lock, current_task);
+		ret = 1;
+	}
+	exit_critical_section();
+
+	return ret;
+}
+
+void mutex_unlock(struct mutex *lock)
+{
+	task_t			*owner;
+	task_t			*next  = NULL;
+	struct mutex_waiter	*waiter;
+
+	enter_critical_section();
+
+	owner = lock->owner;
+
+	if (NULL != owner) {
+		list_del_init(&lock->held);
+	}
+
+	if (list_empty(&lock->wait_list)) {
+		lock->locked = 0;
+		lock->owner  = NULL;
+	}
+	else {
+		waiter = list_first_entry(&lock->wait_list, struct mutex_waiter, list);
+		list_del(&waiter->list);
+
+		next		   = waiter->task;
+		next->blocked_on   = NULL;
+		next->mutex_waiter = NULL;
+		mutex_set_owner(lock, next);
+
+		set_task_state(next, READY);
+		sched_enqueue_task(next, ENQUEUE_WAKEUP);
+		mutex_adjust_chain(next);
+	}
+
+	if (NULL != owner) {
+		mutex_adjust_chain(owner);
+	}
+
+	/* a higher priority new owner runs once the critical section is left */
+	if (NULL != next) {
+		sched_check_preempt(next);
+	}
+
+	exit_critical_section();
+}
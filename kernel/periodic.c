@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <kernel/task.h>
+#include <kernel/printk.h>
+#include <kernel/types.h>
+#include <kernel/sched.h>
+#include <kernel/timer.h>
+
+//#define DEBUG           1
+#include <kernel/debug.h>
+
+/*
+ * Periodic tasks with rate-monotonic priorities: the shorter the period
+ * the higher the priority, PERIODIC_PRIO_BASE for the shortest. A task
+ * is only admitted while the total utilization stays within the Liu and
+ * Layland bound n(2^(1/n) - 1). Releases are absolute, each one period
+ * after the previous, so sleeping never adds drift.
+ */
+static LIST_HEAD(periodic_list);
+static int		 periodic_count;
+static unsigned long	 periodic_util;		/* parts per million */
+
+/* n(2^(1/n) - 1) in parts per million, rounded down; ln 2 beyond */
+static const unsigned long rm_bound[] = {
+	1000000, 828427, 779763, 756828, 743491,
+	 734772, 728626, 724061, 720537, 717734,
+};
+
+static unsigned long rm_utilization_bound(int n)
+{
+	if (n <= (int)(sizeof(rm_bound) / sizeof(rm_bound[0]))) {
+		return rm_bound[n - 1];
+	}
+
+	return 693147;
+}
+
+/* wcet / period in parts per million, rounded up */
+static unsigned long rm_task_util(unsigned long period, unsigned long wcet)
+{
+	return (unsigned long)(((unsigned long long)wcet * 1000000 + period - 1) / period);
+}
+
+/* keep a boost from priority inheritance, see kernel/mutex.c */
+static void periodic_set_priority(task_t *p, unsigned int prio)
+{
+	if ((p->priority == p->base_priority) || (prio < p->priority)) {
+		sched_set_priority(p, prio);
+	}
+	p->base_priority = prio;
+}
+
+/* give every periodic task its rank in period order as priority */
+static void periodic_assign_priorities(void)
+{
+	task_t		*p;
+	unsigned int	 prio = PERIODIC_PRIO_BASE;
+
+	list_for_each_entry(p, &periodic_list, periodic.list) {
+		periodic_set_priority(p, prio++);
+	}
+}
+
+/* cpu time used so far in microseconds, including the current run */
+static unsigned long long periodic_cpu_time(task_t *p)
+{
+	unsigned long long cpu;
+
+	enter_critical_section();
+	cpu = p->runtime + (current_time_hires() - p->last_run);
+	exit_critical_section();
+
+	return cpu;
+}
+
+static int periodic_main(void *args)
+{
+	task_t			*p = current_task;
+	unsigned long long	 cpu;
+	unsigned long		 now;
+	int			 ret;
+
+	for (;;) {
+		cpu = periodic_cpu_time(p);
+
+		ret = p->periodic.entry(args);
+		if (ret) {
+			return ret;
+		}
+
+		p->periodic.jobs++;
+		if (periodic_cpu_time(p) - cpu > (unsigned long long)p->periodic.wcet * 1000) {
+			p->periodic.overruns++;
+		}
+
+		p->periodic.release += p->periodic.period;
+
+		/* the job ran into later periods, skip their releases */
+		now = (unsigned long)current_time();
+		while ((signed long)(now - p->periodic.release) > 0) {
+			p->periodic.missed++;
+			p->periodic.release += p->periodic.period;
+		}
+
+		task_sleep_ms_until(p->periodic.release);
+	}
+
+	return 0;
+}
+
+/*
+ * Create a task that calls entry(args) once every period milliseconds
+ * for as long as it returns 0, starting now. wcet is the most time in
+ * milliseconds one call may take; the task is refused if the set of
+ * periodic tasks would no longer be schedulable with it. The task is
+ * detached, the reaper frees it once entry returns nonzero.
+ */
+task_t *task_create_periodic(char *name, unsigned long period, unsigned long wcet,
+			     task_routine entry, void *args)
+{
+	task_t		*task;
+	task_t		*iterator;
+	unsigned long	 util;
+
+	if ((NULL == entry) || (0 == period) || (0 == wcet) || (wcet > period)) {
+		return NULL;
+	}
+
+	util = rm_task_util(period, wcet);
+
+	enter_critical_section();
+	if ((periodic_count >= PERIODIC_MAX_TASKS) ||
+	    (periodic_util + util > rm_utilization_bound(periodic_count + 1))) {
+		exit_critical_section();
+		dbg("%s not admitted\n", name);
+		return NULL;
+	}
+	periodic_count++;
+	periodic_util += util;
+	exit_critical_section();
+
+	task = task_alloc(name, 0, PERIODIC_PRIO_BASE);
+	if (NULL == task) {
+		goto out;
+	}
+
+	task->periodic.entry   = entry;
+	task->periodic.period  = period;
+	task->periodic.wcet    = wcet;
+	task->periodic.release = (unsigned long)current_time();
+
+	enter_critical_section();
+	list_for_each_entry(iterator, &periodic_list, periodic.list) {
+		if (period < iterator->periodic.period) {
+			break;
+		}
+	}
+	list_add_tail(&task->periodic.list, &iterator->periodic.list);
+	periodic_assign_priorities();
+	exit_critical_section();
+
+	if (task_create(task, periodic_main, args)) {
+		enter_critical_section();
+		list_del(&task->periodic.list);
+		/* close the gap it left in the ranks */
+		periodic_assign_priorities();
+		exit_critical_section();
+		task_free(task);
+		goto out;
+	}
+	task_detach(task);
+
+	return task;
+
+out:
+	enter_critical_section();
+	periodic_count--;
+	periodic_util -= util;
+	exit_critical_section();
+
+	return NULL;
+}
+
+/* called by task_exit(), gives the task's share of the cpu back */
+void task_periodic_exit(task_t *task)
+{
+	if (0 == task->periodic.period) {
+		return;
+	}
+
+	enter_critical_section();
+	list_del(&task->periodic.list);
+	periodic_count--;
+	periodic_util -= rm_task_util(task->periodic.period, task->periodic.wcet);
+	task->periodic.period = 0;
+	exit_critical_section();
+}
+
+/* admitted utilization and the bound for that many tasks, in ppm */
+void periodic_utilization(unsigned long *util, unsigned long *bound)
+{
+	enter_critical_section();
+	*util  = periodic_util;
+	*bound = periodic_count ? rm_utilization_bound(periodic_count) : 1000000;
+	exit_critical_section();
+}
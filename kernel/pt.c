@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <kernel/types.h>
+#include <kernel/task.h>
+#include <kernel/sched.h>
+#include <kernel/timer.h>
+#include <kernel/semaphore.h>
+#include <kernel/pt.h>
+
+//#define DEBUG           1
+#include <kernel/debug.h>
+
+/*
+ * All protothreads run on the "pt" task, one call at a time, in the
+ * order they became ready. Sleepers are kept by deadline and cost one
+ * kernel timer between them, armed for the earliest while the runner
+ * has nothing else to do.
+ */
+#define PT_PRIORITY	96
+
+struct pt_stats		 pt_stats;
+
+static task_t		*pt_task;
+static LIST_HEAD(pt_ready);
+static LIST_HEAD(pt_sleeping);
+static struct semaphore	 pt_kick_sem = __SEMAPHORE_INITIALIZER(pt_kick_sem, 0);
+static int		 pt_idle;
+static timer_t		 pt_timer;
+
+/* wake the runner if it waits for work, any context */
+static void pt_kick(void)
+{
+	enter_critical_section();
+	if (pt_idle) {
+		pt_idle = 0;
+		up(&pt_kick_sem);
+	}
+	exit_critical_section();
+}
+
+/* make a waiting protothread ready, any context */
+void pt_wake(struct pt *pt)
+{
+	enter_critical_section();
+	list_del_init(&pt->list);
+	list_add_tail(&pt->list, &pt_ready);
+	pt_kick();
+	exit_critical_section();
+}
+
+void pt_start(struct pt *pt, pt_func func)
+{
+	pt->func = func;
+	pt->lc	 = 0;
+	INIT_LIST_HEAD(&pt->list);
+
+	enter_critical_section();
+	pt_stats.started++;
+	pt_stats.live++;
+	exit_critical_section();
+
+	pt_wake(pt);
+}
+
+/* used by PT_SLEEP(), called from the protothread */
+void pt_sleep(struct pt *pt, unsigned long ms)
+{
+	struct pt *iterator;
+
+	pt->wake = (unsigned long)current_time() + (ms ? ms : 1);
+
+	enter_critical_section();
+	list_for_each_entry(iterator, &pt_sleeping, list) {
+		if ((signed long)(pt->wake - iterator->wake) < 0) {
+			break;
+		}
+	}
+	list_add_tail(&pt->list, &iterator->list);
+	exit_critical_section();
+}
+
+/*
+ * Used by PT_SEM_DOWN(): take the semaphore if it is free and return 0,
+ * else queue up on it and return 1; up() hands it over with pt_wake().
+ */
+int pt_sem_down(struct pt *pt, struct semaphore *sem)
+{
+	struct semaphore_waiter *iterator;
+
+	enter_critical_section();
+
+	if (sem->count > 0) {
+		sem->count--;
+		exit_critical_section();
+		return 0;
+	}
+
+	list_for_each_entry(iterator, &sem->wait_list, list) {
+		if (task_wait_priority(pt_task) < task_wait_priority(iterator->task)) {
+			break;
+		}
+	}
+	list_add_tail(&pt->u.sem.list, &iterator->list);
+	pt->u.sem.task = pt_task;
+	pt->u.sem.pt   = pt;
+	pt->u.sem.up   = 0;
+
+	exit_critical_section();
+
+	return 1;
+}
+
+static int pt_wake_function(wait_queue_t *wait)
+{
+	struct pt *pt = wait->private;
+
+	list_del_init(&wait->task_list);
+	pt_wake(pt);
+
+	return 1;
+}
+
+/*
+ * Used by PT_WAIT_FOR_COMPLETION(): consume a completion and return 0,
+ * or wait on its queue and return 1.
+ */
+int pt_wait_for_completion(struct pt *pt, struct completion *x)
+{
+	enter_critical_section();
+
+	if (x->done) {
+		x->done--;
+		exit_critical_section();
+		return 0;
+	}
+
+	init_waitqueue_func_entry(&pt->u.wait, pt_wake_function);
+	pt->u.wait.private = pt;
+	__add_wait_queue_tail_exclusive(&x->wait, &pt->u.wait);
+
+	exit_critical_section();
+
+	return 1;
+}
+
+static handler_return pt_timer_function(timer_t *timer, unsigned long now, void *arg)
+{
+	pt_kick();
+
+	return INT_NO_RESCHEDULE;
+}
+
+/* move the sleepers that are due to the ready list */
+static void pt_expire(unsigned long now)
+{
+	struct pt *pt;
+
+	while (!list_empty(&pt_sleeping)) {
+		pt = list_first_entry(&pt_sleeping, struct pt, list);
+		if ((signed long)(pt->wake - now) > 0) {
+			break;
+		}
+		list_move_tail(&pt->list, &pt_ready);
+	}
+}
+
+static int pt_runner(void *arg)
+{
+	struct pt	*pt;
+	struct pt	*first;
+	unsigned long	 now;
+	int		 ret;
+
+	for (;;) {
+		enter_critical_section();
+
+		now = (unsigned long)current_time();
+		pt_expire(now);
+
+		if (list_empty(&pt_ready)) {
+			if (!list_empty(&pt_sleeping)) {
+				first = list_first_entry(&pt_sleeping, struct pt, list);
+				oneshot_timer_add(&pt_timer, first->wake - now,
+						  (timer_function)pt_timer_function, NULL);
+			}
+			pt_idle = 1;
+			exit_critical_section();
+
+			down(&pt_kick_sem);
+			timer_delete(&pt_timer);
+			continue;
+		}
+
+		pt = list_first_entry(&pt_ready, struct pt, list);
+		list_del_init(&pt->list);
+		pt_stats.runs++;
+
+		exit_critical_section();
+
+		ret = pt->func(pt);
+
+		enter_critical_section();
+		if (PT_YIELDED == ret) {
+			list_add_tail(&pt->list, &pt_ready);
+		}
+		else if ((PT_EXITED == ret) || (PT_ENDED == ret)) {
+			pt_stats.live--;
+		}
+		exit_critical_section();
+	}
+
+	return 0;
+}
+
+void pt_init(void)
+{
+	init_timer_value(&pt_timer);
+
+	pt_task = task_alloc("pt", 0x800, PT_PRIORITY);
+	if ((NULL == pt_task) || task_create(pt_task, pt_runner, NULL)) {
+		error("Create protothread task failed\n");
+		return;
+	}
+	task_detach(pt_task);
+}
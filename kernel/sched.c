@@ -25,15 +25,146 @@
 #include <kernel/printk.h>
 #include <kernel/types.h>
 #include <kernel/sched.h>
+#include <kernel/timer.h>
 
 //#define DEBUG           1
 #include <kernel/debug.h>
 
-struct sched_class		*scheduler = NULL;
-extern struct sched_class	 sched_class_fifo;
+/* the highest class, the others are reached through ->next */
+const struct sched_class	*scheduler = NULL;
 
 void sched_init()
 {
-	scheduler = &sched_class_fifo;
-	scheduler->init();
+	const struct sched_class *class;
+
+	scheduler = &sched_class_cyclic;
+	for (class = scheduler; class; class = class->next) {
+		class->init();
+	}
+}
+
+void sched_enqueue_task(task_t *p, int flags)
+{
+	/* start the wakeup latency clock, see task_account_switch() */
+	if ((flags & ENQUEUE_WAKEUP) && list_empty(&p->list)) {
+		p->wakeup_time = current_time_hires();
+	}
+
+	p->sched_class->enqueue_task(p, flags);
+}
+
+void sched_dequeue_task(task_t *p, int flags)
+{
+	p->sched_class->dequeue_task(p, flags);
+}
+
+/*
+ * A task was just woken up: flag a reschedule if it may run before the
+ * current one. Equal priorities are flagged too, pick_next_task() keeps
+ * the fifo order among them.
+ */
+void sched_check_preempt(task_t *p)
+{
+	if (NULL == current_task) {
+		return;
+	}
+
+	if (task_wait_priority(p) <= task_wait_priority(current_task)) {
+		need_resched = 1;
+	}
+}
+
+/* ask each class in turn, the first one with a runnable task wins */
+task_t *sched_pick_next_task(void)
+{
+	const struct sched_class	*class;
+	task_t				*p;
+
+	for (class = scheduler; class; class = class->next) {
+		p = class->pick_next_task();
+		if (NULL != p) {
+			p->state     = RUNNING;
+			current_task = p;
+			return p;
+		}
+	}
+
+	return NULL;
+}
+
+void sched_dump(void)
+{
+	const struct sched_class *class;
+
+	for (class = scheduler; class; class = class->next) {
+		class->dump();
+	}
+}
+
+/* move a task to another class, requeueing it if it is runnable */
+void sched_set_class(task_t *p, const struct sched_class *class)
+{
+	int queued;
+
+	enter_critical_section();
+
+	queued = !list_empty(&p->list);
+	if (queued) {
+		sched_dequeue_task(p, 0);
+	}
+
+	p->sched_class = class;
+
+	if (queued) {
+		sched_enqueue_task(p, 0);
+	}
+
+	exit_critical_section();
+}
+
+/* change the priority of a task, requeueing it if it is runnable */
+void sched_set_priority(task_t *p, unsigned int priority)
+{
+	int queued;
+
+	enter_critical_section();
+
+	queued = !list_empty(&p->list);
+	if (queued) {
+		sched_dequeue_task(p, 0);
+	}
+
+	p->priority = priority;
+
+	if (queued) {
+		sched_enqueue_task(p, 0);
+	}
+
+	exit_critical_section();
+}
+
+/*
+ * Advance the frame table and charge the running task for one tick,
+ * nonzero asks for a reschedule.
+ */
+int sched_tick(void)
+{
+	int resched = sched_cyclic_tick();
+
+	if (NULL == current_task) {
+		return resched;
+	}
+
+	task_account_tick(current_task);
+
+	/* its group just ran out of budget */
+	if (task_group_throttled(current_task)) {
+		resched = 1;
+	}
+
+	if (NULL == current_task->sched_class->task_tick) {
+		return resched;
+	}
+
+	return current_task->sched_class->task_tick(current_task) || resched;
 }
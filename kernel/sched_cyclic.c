@@ -0,0 +1,343 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include <kernel/task.h>
+#include <kernel/printk.h>
+#include <kernel/types.h>
+#include <kernel/sched.h>
+#include <kernel/timer.h>
+#include <arch/timer.h>
+
+//#define DEBUG           1
+#include <kernel/debug.h>
+
+/*
+ * Cyclic executive. A major frame is a fixed sequence of minor frames,
+ * each minor_ticks long and owned by one job, or by nobody. The owner
+ * of the current minor frame runs ahead of every other class until it
+ * calls task_wait_frame(); the rest of the frame, and frames without an
+ * owner, go to the EDF and FIFO classes. A job that has not called
+ * task_wait_frame() by the end of its frame overran: it is counted and
+ * put aside until its next frame, so the table keeps its timing.
+ * Frames end by the clock, minor_ticks ticks after they began, so a
+ * late or lost tick does not stretch the frame it falls in.
+ */
+#define CYCLIC_TICK_NSEC	(NSEC_PER_SEC / HZ)
+
+struct cyclic_job {
+	task_t		*task;
+	int		 waiting;	/* blocked in task_wait_frame() */
+	int		 dispatched;	/* picked in the current frame */
+	unsigned long	 frames;
+	unsigned long	 overruns;
+};
+
+static const struct cyclic_table	*cyclic_table;
+static struct cyclic_job		 cyclic_jobs[CYCLIC_MAX_JOBS];
+static LIST_HEAD(cyclic_rq);
+static unsigned int			 cyclic_frame;
+static unsigned long long		 cyclic_frame_end;	/* ns */
+static unsigned long long		 cyclic_frame_start;
+
+struct cyclic_stats			 cyclic_stats;
+
+static struct cyclic_job *cyclic_frame_job(void)
+{
+	unsigned int id = cyclic_table->frames[cyclic_frame];
+
+	if ((CYCLIC_IDLE == id) || (NULL == cyclic_jobs[id].task)) {
+		return NULL;
+	}
+
+	return &cyclic_jobs[id];
+}
+
+/* a new minor frame starts, release its job if it is waiting for it */
+static void cyclic_begin_frame(void)
+{
+	struct cyclic_job *job = cyclic_frame_job();
+
+	cyclic_frame_start = current_time_hires();
+
+	if (NULL == job) {
+		cyclic_stats.idle_frames++;
+		return;
+	}
+
+	job->frames++;
+	job->dispatched = 0;
+
+	if (job->waiting) {
+		job->waiting	 = 0;
+		job->task->state = READY;
+		sched_enqueue_task(job->task, ENQUEUE_WAKEUP);
+	}
+}
+
+static void sched_cyclic_init (void)
+{
+	INIT_LIST_HEAD(&cyclic_rq);
+}
+
+static void sched_cyclic_dump ()
+{
+	task_t *task;
+
+	printk("\ncyclic tasks:");
+	list_for_each_entry(task, &cyclic_rq, list) {
+		printk(" %s(%d) ", task->name, task->cyclic_job);
+	}
+	printk("\n");
+}
+
+static void sched_cyclic_enqueue_task (task_t *p, int flags)
+{
+	if (!list_empty(&p->list)) {
+		return;
+	}
+
+	list_add_tail(&p->list, &cyclic_rq);
+}
+
+static void sched_cyclic_dequeue_task (task_t *p, int flags)
+{
+	list_del_init(&p->list);
+}
+
+/* only the owner of the current frame, and only while it is runnable */
+static task_t * sched_cyclic_pick_next_task (void)
+{
+	struct cyclic_job	*job;
+	unsigned long		 jitter;
+
+	if (NULL == cyclic_table) {
+		return NULL;
+	}
+
+	job = cyclic_frame_job();
+	if ((NULL == job) || list_empty(&job->task->list)) {
+		return NULL;
+	}
+
+	if (!job->dispatched) {
+		job->dispatched = 1;
+		jitter = (unsigned long)(current_time_hires() - cyclic_frame_start);
+		if (jitter > cyclic_stats.jitter_max) {
+			cyclic_stats.jitter_max = jitter;
+		}
+	}
+
+	return job->task;
+}
+
+const struct sched_class sched_class_cyclic = {
+	 .next		 = &sched_class_edf,
+	 .init		 = sched_cyclic_init,
+	 .enqueue_task	 = sched_cyclic_enqueue_task,
+	 .dequeue_task	 = sched_cyclic_dequeue_task,
+	 .pick_next_task = sched_cyclic_pick_next_task,
+	 .task_tick	 = NULL,
+	 .dump		 = sched_cyclic_dump,
+};
+
+static unsigned long long cyclic_minor_ns(void)
+{
+	return (unsigned long long)cyclic_table->minor_ticks * CYCLIC_TICK_NSEC;
+}
+
+/*
+ * Called from sched_tick() on every tick. Closes the minor frame once
+ * its end has come and opens the next one, each frame ending a minor
+ * frame after the last so that the table does not drift. Frames a late
+ * tick went past are opened and overrun in turn. Nonzero asks for a
+ * reschedule.
+ */
+int sched_cyclic_tick(void)
+{
+	struct cyclic_job	*job;
+	unsigned long long	 now;
+
+	if (NULL == cyclic_table) {
+		return 0;
+	}
+
+	now = current_time_ns();
+	if ((long long)(cyclic_frame_end - now) > TICK_SLOP_NS) {
+		return 0;
+	}
+
+	do {
+		job = cyclic_frame_job();
+		if ((NULL != job) && !job->waiting) {
+			job->overruns++;
+			cyclic_stats.overruns++;
+			dbg("%s overran frame %d\n", job->task->name, cyclic_frame);
+		}
+
+		if (++cyclic_frame == cyclic_table->nr_frames) {
+			cyclic_frame = 0;
+			cyclic_stats.major_frames++;
+		}
+
+		cyclic_frame_end += cyclic_minor_ns();
+		cyclic_begin_frame();
+	} while ((long long)(cyclic_frame_end - now) <= TICK_SLOP_NS);
+
+	return 1;
+}
+
+/*
+ * Start running a frame table from its first minor frame. Jobs are
+ * bound to tasks with task_set_cyclic(), before or after.
+ */
+int cyclic_start(const struct cyclic_table *table)
+{
+	unsigned int i;
+
+	if ((NULL == table) || (0 == table->minor_ticks) || (0 == table->nr_frames)) {
+		return -1;
+	}
+
+	for (i = 0; i < table->nr_frames; i++) {
+		if ((CYCLIC_IDLE != table->frames[i]) && (table->frames[i] >= CYCLIC_MAX_JOBS)) {
+			return -1;
+		}
+	}
+
+	enter_critical_section();
+	memset(&cyclic_stats, 0, sizeof(cyclic_stats));
+	cyclic_table	   = table;
+	cyclic_frame	   = 0;
+
+	/* the first frame began on the last tick, if the tick grid is current */
+	cyclic_frame_end = timer_next_tick_ns() - CYCLIC_TICK_NSEC;
+	if ((long long)(current_time_ns() - cyclic_frame_end) > (long long)CYCLIC_TICK_NSEC) {
+		cyclic_frame_end = current_time_ns();
+	}
+	cyclic_frame_end += cyclic_minor_ns();
+	cyclic_begin_frame();
+	need_resched	   = 1;
+	exit_critical_section();
+
+	return 0;
+}
+
+/* stop the table; its tasks stay with the class but do not run */
+void cyclic_stop(void)
+{
+	enter_critical_section();
+	cyclic_table = NULL;
+	need_resched = 1;
+	exit_critical_section();
+}
+
+int cyclic_running(void)
+{
+	return NULL != cyclic_table;
+}
+
+const struct cyclic_table *cyclic_get_table(void)
+{
+	return cyclic_table;
+}
+
+unsigned int cyclic_get_frame(void)
+{
+	return cyclic_frame;
+}
+
+/* per-job counters for the shell, -1 if job is not bound */
+int cyclic_job_stats(unsigned int job, task_t **task, unsigned long *frames,
+		     unsigned long *overruns)
+{
+	if ((job >= CYCLIC_MAX_JOBS) || (NULL == cyclic_jobs[job].task)) {
+		return -1;
+	}
+
+	*task	  = cyclic_jobs[job].task;
+	*frames	  = cyclic_jobs[job].frames;
+	*overruns = cyclic_jobs[job].overruns;
+
+	return 0;
+}
+
+/*
+ * Bind a task to a job of the frame table, it then runs only in that
+ * job's minor frames. CYCLIC_IDLE returns it to the FIFO class.
+ */
+int task_set_cyclic(task_t *task, unsigned int job)
+{
+	if (NULL == task) {
+		return -1;
+	}
+
+	if (CYCLIC_IDLE == job) {
+		if (task->sched_class != &sched_class_cyclic) {
+			return 0;
+		}
+
+		enter_critical_section();
+		cyclic_jobs[task->cyclic_job].task = NULL;
+		exit_critical_section();
+
+		sched_set_class(task, &sched_class_fifo);
+		return 0;
+	}
+
+	if ((job >= CYCLIC_MAX_JOBS) || (NULL != cyclic_jobs[job].task) ||
+	    (task->sched_class == &sched_class_cyclic)) {
+		return -1;
+	}
+
+	enter_critical_section();
+	memset(&cyclic_jobs[job], 0, sizeof(cyclic_jobs[job]));
+	cyclic_jobs[job].task = task;
+	task->cyclic_job      = job;
+	exit_critical_section();
+
+	sched_set_class(task, &sched_class_cyclic);
+
+	return 0;
+}
+
+/*
+ * Called by a cyclic task when its work for the current frame is done,
+ * returns at the start of the job's next minor frame.
+ */
+void task_wait_frame(void)
+{
+	task_t *p = current_task;
+
+	if (p->sched_class != &sched_class_cyclic) {
+		return;
+	}
+
+	enter_critical_section();
+
+	cyclic_jobs[p->cyclic_job].waiting = 1;
+	p->state = SLEEPING;
+	sched_dequeue_task(p, 0);
+	task_schedule();
+
+	exit_critical_section();
+}
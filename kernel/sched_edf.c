@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <kernel/task.h>
+#include <kernel/printk.h>
+#include <kernel/types.h>
+#include <kernel/sched.h>
+#include <kernel/timer.h>
+
+//#define DEBUG           1
+#include <kernel/debug.h>
+
+/*
+ * Earliest-deadline-first class. Deadline tasks are kept on edf_rq in
+ * absolute deadline order and always run ahead of the FIFO class.
+ * A job is released either by task_wait_period() for periodic tasks or
+ * by the first wakeup after a sporadic task finished its previous job.
+ */
+#define EDF_NEW_JOB	0x01
+#define EDF_MISSED	0x02
+
+static LIST_HEAD(edf_rq);
+
+static inline int deadline_before(unsigned long a, unsigned long b)
+{
+	return (signed long)(a - b) < 0;
+}
+
+static void edf_start_job(task_t *p, unsigned long release)
+{
+	p->release	= release;
+	p->abs_deadline = release + p->deadline;
+	p->edf_flags   &= ~(EDF_NEW_JOB | EDF_MISSED);
+}
+
+static void edf_check_deadline(task_t *p, unsigned long now)
+{
+	if (!(p->edf_flags & EDF_MISSED) && deadline_before(p->abs_deadline, now)) {
+		p->edf_flags |= EDF_MISSED;
+		p->deadline_misses++;
+		dbg("%s missed its deadline\n", p->name);
+	}
+}
+
+static void sched_edf_init (void)
+{
+	INIT_LIST_HEAD(&edf_rq);
+}
+
+static void sched_edf_dump ()
+{
+	task_t *task;
+
+	printk("\nedf tasks:");
+	list_for_each_entry(task, &edf_rq, list) {
+		printk(" %s(%d) ", task->name, (int)task->abs_deadline);
+	}
+	printk("\n");
+}
+
+static void sched_edf_enqueue_task (task_t *p, int flags)
+{
+	task_t *iterator;
+
+	if (!list_empty(&p->list)) {
+		return;
+	}
+
+	if (p->edf_flags & EDF_NEW_JOB) {
+		edf_start_job(p, current_time());
+	}
+
+	list_for_each_entry(iterator, &edf_rq, list) {
+		if (deadline_before(p->abs_deadline, iterator->abs_deadline)) {
+			break;
+		}
+	}
+	/* before the first later deadline, or at the tail */
+	list_add_tail(&p->list, &iterator->list);
+}
+
+static void sched_edf_dequeue_task (task_t *p, int flags)
+{
+	list_del_init(&p->list);
+}
+
+static task_t * sched_edf_pick_next_task (void)
+{
+	task_t		*p;
+	unsigned long	 now;
+
+	if (list_empty(&edf_rq)) {
+		return NULL;
+	}
+
+	/*
+	 * The tick only checks the running task, flag the jobs still waiting
+	 * for the cpu too. In deadline order, so only those already late.
+	 */
+	now = current_time();
+	list_for_each_entry(p, &edf_rq, list) {
+		if (!deadline_before(p->abs_deadline, now)) {
+			break;
+		}
+		edf_check_deadline(p, now);
+	}
+
+	return list_first_entry(&edf_rq, task_t, list);
+}
+
+static int sched_edf_task_tick (task_t *p)
+{
+	edf_check_deadline(p, current_time());
+	return 0;
+}
+
+const struct sched_class sched_class_edf = {
+	 .next		 = &sched_class_fifo,
+	 .init		 = sched_edf_init,
+	 .enqueue_task	 = sched_edf_enqueue_task,
+	 .dequeue_task	 = sched_edf_dequeue_task,
+	 .pick_next_task = sched_edf_pick_next_task,
+	 .task_tick	 = sched_edf_task_tick,
+	 .dump		 = sched_edf_dump,
+};
+
+/*
+ * Make a task a deadline task: every job must complete within deadline
+ * ms of its release, and a new job is released each period ms (0 for
+ * sporadic tasks). A zero deadline returns it to the FIFO class.
+ */
+int task_set_deadline(task_t *task, unsigned long deadline, unsigned long period)
+{
+	if (NULL == task) {
+		return -1;
+	}
+
+	if (0 == deadline) {
+		sched_set_class(task, &sched_class_fifo);
+		return 0;
+	}
+
+	if (period && (deadline > period)) {
+		return -1;
+	}
+
+	enter_critical_section();
+	task->deadline	      = deadline;
+	task->period	      = period;
+	task->deadline_misses = 0;
+	task->edf_flags	      = EDF_NEW_JOB;
+	exit_critical_section();
+
+	sched_set_class(task, &sched_class_edf);
+
+	return 0;
+}
+
+/*
+ * Called by a deadline task when its current job is done. Periodic
+ * tasks sleep until their next release, absolute so that releases do
+ * not drift; sporadic tasks get a fresh deadline the next time they are
+ * woken.
+ */
+void task_wait_period(void)
+{
+	task_t		*p   = current_task;
+	unsigned long	 now = current_time();
+
+	if (p->sched_class != &sched_class_edf) {
+		return;
+	}
+
+	enter_critical_section();
+
+	edf_check_deadline(p, now);
+
+	if (0 == p->period) {
+		p->edf_flags |= EDF_NEW_JOB;
+		exit_critical_section();
+		return;
+	}
+
+	/* edf_rq is ordered by abs_deadline, don't change it while linked */
+	sched_dequeue_task(p, 0);
+	edf_start_job(p, p->release + p->period);
+	sched_enqueue_task(p, 0);
+
+	if (deadline_before(now, p->release)) {
+		exit_critical_section();
+		task_sleep_ms_until(p->release);
+		return;
+	}
+
+	/* overran into the next period, an earlier deadline may run first */
+	task_schedule();
+
+	exit_critical_section();
+}
@@ -25,14 +25,76 @@
 #include <kernel/types.h>
 #include <kernel/sched.h>
 #include <kernel/bitops.h>
+#include <kernel/trace.h>
+#include <arch/arch.h>
 
 //#define DEBUG           1
 #include <kernel/debug.h>
 
+/*
+ * Only runnable tasks live on all_task[]: sleeping, blocked and exited
+ * tasks are dequeued before they give up the cpu. Priority 0 is the
+ * highest one. The ready priorities are kept in a two-level bitmap: bit
+ * g of task_group_bitmap says that task_bitmap[g] is non-zero, and each
+ * task_bitmap[] word covers BITS_PER_LONG priorities. Both levels store
+ * the highest priority in the most significant bit, so finding the
+ * highest ready priority costs two clz.
+ */
+#define PRIO_GROUPS		(MAX_PRIORITY / BITS_PER_LONG)
+#define PRIO_GROUP(prio)	((prio) / BITS_PER_LONG)
+#define PRIO_TO_BIT(prio)	(BITS_PER_LONG - 1 - ((prio) % BITS_PER_LONG))
+
 struct list_head	 all_task[MAX_PRIORITY];
-unsigned long		 task_bitmap;
+unsigned long		 task_group_bitmap;
+unsigned long		 task_bitmap[PRIO_GROUPS];
 extern task_t		*current_task;
-extern task_t		*next_task;
+
+#ifdef CONFIG_SCHED_RR
+#ifndef CONFIG_SCHED_RR_DEFAULT_SLICE
+#define CONFIG_SCHED_RR_DEFAULT_SLICE	10
+#endif
+
+int			 sched_rr_enabled = 1;
+static unsigned short	 rr_slice[MAX_PRIORITY];
+
+static inline unsigned int task_time_slice(task_t *p)
+{
+	return p->time_slice ? p->time_slice : rr_slice[p->priority];
+}
+
+int sched_rr_set_slice(unsigned int priority, unsigned int ticks)
+{
+	if ((priority >= MAX_PRIORITY) || (0 == ticks) || (ticks > 0xffff)) {
+		return -1;
+	}
+
+	rr_slice[priority] = ticks;
+	return 0;
+}
+
+unsigned int sched_rr_get_slice(unsigned int priority)
+{
+	if (priority >= MAX_PRIORITY) {
+		return 0;
+	}
+
+	return rr_slice[priority];
+}
+
+int task_set_time_slice(task_t *task, unsigned int ticks)
+{
+	if (NULL == task) {
+		return -1;
+	}
+
+	enter_critical_section();
+	task->time_slice = ticks;
+	task->time_left  = task_time_slice(task);
+	exit_critical_section();
+
+	return 0;
+}
+#endif
 
 void sched_fifo_init (void)
 {
@@ -41,6 +103,17 @@ void sched_fifo_init (void)
 	for (i=0; i< MAX_PRIORITY; i++) {
 		INIT_LIST_HEAD(&all_task[i]);
 	}
+
+	task_group_bitmap = 0;
+	for (i=0; i< PRIO_GROUPS; i++) {
+		task_bitmap[i] = 0;
+	}
+
+	#ifdef CONFIG_SCHED_RR
+	for (i=0; i< MAX_PRIORITY; i++) {
+		rr_slice[i] = CONFIG_SCHED_RR_DEFAULT_SLICE;
+	}
+	#endif
 }
 
 static void sched_fifo_dump ()
@@ -48,7 +121,7 @@ static void sched_fifo_dump ()
 	task_t                  *task;
 	struct list_head        *list;
 
-	printk("\ntasks:");
+	printk("\nfifo tasks:");
 	list_for_each(list, &all_task[current_task->priority]) {
 		task = (task_t *)list;
 		printk(" %s ", task->name);
@@ -56,107 +129,118 @@ static void sched_fifo_dump ()
 	printk("\n");
 }
 
-static task_t *_find_next_task(unsigned int priority, struct list_head *start)
+static void sched_fifo_enqueue_task (task_t *p, int flags)
 {
-	task_t           *task;
-	struct list_head *iterator;
-
-	list_for_each(iterator, start) {
-		task = (task_t *)iterator;
-		dbg("new_task=%s\n", task->name);
-		if ((iterator == &all_task[priority]) || (task->state == BLOCKED)) {
-			continue;
-		}
-		else {
-			break;
-		}
+	if (!list_empty(&p->list)) {
+		return;
 	}
-	if (iterator == start) {
-		task = NULL;
+
+	#ifdef CONFIG_SCHED_RR
+	p->time_left = task_time_slice(p);
+	#endif
+
+	/* out of budget, it waits for the group's replenishment */
+	if (task_group_throttled(p)) {
+		task_group_park(p);
+		return;
+	}
+
+	if (flags & ENQUEUE_WAKEUP) {
+		wakeup_trace_wakeup(p);
 	}
-	
-	return task;
-}
 
-static void sched_fifo_enqueue_task (task_t *p, int flags)
-{
 	list_add_tail(&p->list, &all_task[p->priority]);
-	set_bit(p->priority, &task_bitmap);
+	set_bit(PRIO_TO_BIT(p->priority), &task_bitmap[PRIO_GROUP(p->priority)]);
+	set_bit(PRIO_TO_BIT(PRIO_GROUP(p->priority)), &task_group_bitmap);
 }
 
 static void sched_fifo_dequeue_task (task_t *p, int flags)
 {
-	next_task = _find_next_task(p->priority, &p->list);
+	if (list_empty(&p->list)) {
+		return;
+	}
 
-	list_del(&p->list);
+	list_del_init(&p->list);
 	if (list_empty(&all_task[p->priority])) {
-		clear_bit(p->priority, &task_bitmap);
+		unsigned int group = PRIO_GROUP(p->priority);
+
+		clear_bit(PRIO_TO_BIT(p->priority), &task_bitmap[group]);
+		if (0 == task_bitmap[group]) {
+			clear_bit(PRIO_TO_BIT(group), &task_group_bitmap);
+		}
 	}
 }
 
 static task_t * sched_fifo_pick_next_task (void)
 {
-	struct list_head    *list     = &current_task->list;
-	#ifdef DEBUG
-	task_t              *old_task = current_task;
-	#endif
 	task_t              *new_task;
-	int                  i;
-	struct list_head    *current_list;
+	unsigned int         group;
+	unsigned int         prio;
 
 	#ifdef  DEBUG
 	sched_fifo_dump();
 	#endif
 
-	for (i=0; i<MAX_PRIORITY; i++) {
-		if (0 == test_bit(i, &task_bitmap)) {
-			continue;
+	for (;;) {
+		if (0 == task_group_bitmap) {
+			return NULL;
 		}
 
-		if (i != (int)current_task->priority) {
-			current_list = &all_task[i];
-		}
-		else {
-			if ( (current_task->state == EXITED)	||
-			     (current_task->state == SLEEPING) ) {
-				if (NULL != next_task) {
-					dbg("next_task=%s\n", next_task->name);
-					new_task  = next_task;
-					next_task = NULL;
-					break;
-				}
-				else {
-					continue;
-				}
-			}
-
-			current_list = list;
-		}
-			
-		new_task = _find_next_task(i, current_list);
-		if (NULL == new_task) {
-			continue;
+		group    = __clz(task_group_bitmap);
+		prio     = group * BITS_PER_LONG + __clz(task_bitmap[group]);
+		new_task = list_first_entry(&all_task[prio], task_t, list);
+
+		if (!task_group_throttled(new_task)) {
+			break;
 		}
-		break;
+
+		/* its group ran out of budget since it was queued */
+		sched_fifo_dequeue_task(new_task, 0);
+		task_group_park(new_task);
 	}
 
-	if (MAX_PRIORITY == i) {
-		return NULL;
+	wakeup_trace_pick(new_task);
+
+	dbg("old_task=%s, new_task=%s\n", current_task->name, new_task->name);
+
+	return new_task;
+}
+
+/*
+ * Round-robin among tasks of the same priority: once the running task
+ * has used up its slice it goes to the tail of its list.
+ */
+static int sched_fifo_task_tick (task_t *p)
+{
+	#ifdef CONFIG_SCHED_RR
+	if (!sched_rr_enabled || (NULL == p) || list_empty(&p->list)) {
+		return 0;
 	}
 
-	new_task->state = RUNNING;
-	current_task    = new_task;
+	if (p->time_left > 1) {
+		p->time_left--;
+		return 0;
+	}
 
-	dbg("old_task=%s, new_task=%s\n", old_task->name, new_task->name);
+	p->time_left = task_time_slice(p);
+	if (list_is_singular(&all_task[p->priority])) {
+		return 0;
+	}
 
-	return current_task;
+	list_move_tail(&p->list, &all_task[p->priority]);
+	return 1;
+	#else
+	return 0;
+	#endif
 }
 
 
 const struct sched_class sched_class_fifo = {
+	 .next		 = NULL,
 	 .init		 = sched_fifo_init,
 	 .enqueue_task	 = sched_fifo_enqueue_task,
 	 .dequeue_task	 = sched_fifo_dequeue_task,
 	 .pick_next_task = sched_fifo_pick_next_task,
+	 .task_tick	 = sched_fifo_task_tick,
 	 .dump		 = sched_fifo_dump,
 };
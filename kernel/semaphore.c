@@ -1,30 +1,33 @@
 #include <kernel/types.h>
 #include <kernel/task.h>
 #include <kernel/semaphore.h>
+#include <kernel/sched.h>
+#include <kernel/pt.h>
 #include <compiler.h>
 
-struct semaphore_waiter {
-	struct list_head	 list;
-	task_t			*task;
-	int			 up;
-};
-
 extern task_t	*current_task;
 
 static inline int __down(struct semaphore *sem)
 {
 	task_t *task = current_task;
 	struct semaphore_waiter waiter;
+	struct semaphore_waiter *iterator;
 
-	list_add_tail(&waiter.list, &sem->wait_list);
+	/* highest priority first, fifo among equals */
+	list_for_each_entry(iterator, &sem->wait_list, list) {
+		if (task_wait_priority(task) < task_wait_priority(iterator->task))
+			break;
+	}
+	list_add_tail(&waiter.list, &iterator->list);
 	waiter.task = task;
+	waiter.pt   = NULL;
 	waiter.up   = 0;
 
+	/* called with the critical section held by down() */
 	for (;;) {
 		set_task_state(task, BLOCKED);
-		enter_critical_section();
+		sched_dequeue_task(task, 0);
 		task_schedule();
-		exit_critical_section();
 		if (waiter.up)
 			return 0;
 	}
@@ -38,7 +41,16 @@ static noinline void __up(struct semaphore *sem)
 	struct semaphore_waiter *waiter = list_first_entry(&sem->wait_list, struct semaphore_waiter, list);
 	list_del(&waiter->list);
 	waiter->up = 1;
+
+	/* the count goes to the protothread, its runner gets woken */
+	if (NULL != waiter->pt) {
+		pt_wake(waiter->pt);
+		return;
+	}
+
 	set_task_state(waiter->task, READY);
+	sched_enqueue_task(waiter->task, ENQUEUE_WAKEUP);
+	sched_check_preempt(waiter->task);
 }
 
 void down(struct semaphore *sem)
@@ -24,25 +24,286 @@
 #include <kernel/task.h>
 #include <kernel/printk.h>
 #include <mm/malloc.h>
+#include <mm/slob.h>
 #include <kernel/types.h>
 #include <kernel/timer.h>
 #include <arch/arch_task.h>
 #include <kernel/sched.h>
 #include <kernel/wait_queue.h>
+#include <kernel/semaphore.h>
+#include <kernel/irq.h>
+#ifdef CONFIG_STACK_GUARD
+#include <arch/mmu.h>
+#endif
 
 //#define DEBUG           1
 #include <kernel/debug.h>
 
 #define STACK_DEF_SIZE    (0x2000)
-#define DEFAULT_PRIORITY  (MAX_PRIORITY - 2)
+#define DEFAULT_PRIORITY  (IDLE_PRIORITY - 1)
 #define INIT_TASK_NAME    "init"
 
 task_t				*current_task;
-task_t				*next_task;
 int				 critical_section_count = 0;
-extern struct sched_class	*scheduler;
+int				 need_resched = 0;
 extern uint32_t			*kernel_pgd;
-static int pid = 0;
+LIST_HEAD(task_list);
+
+/* pids in use, one bit each */
+static unsigned long	 pid_map[PID_MAX / 32];
+static int		 pid_last = -1;
+
+/*
+ * Freed task_t's and stacks of the common sizes are kept for the next
+ * task_alloc()/task_create() instead of going back through kmalloc.
+ */
+#define TASK_POOL_DEPTH		16
+#define STACK_POOL_DEPTH	8
+
+static LIST_HEAD(task_pool);
+static unsigned int	 task_pool_count;
+
+struct stack_pool {
+	unsigned int		size;
+	unsigned int		count;
+	struct list_head	free;
+};
+
+static struct stack_pool stack_pools[] = {
+	{ 0x400,	  0, LIST_HEAD_INIT(stack_pools[0].free) },
+	{ 0x800,	  0, LIST_HEAD_INIT(stack_pools[1].free) },
+	{ 0x1000,	  0, LIST_HEAD_INIT(stack_pools[2].free) },
+	{ STACK_DEF_SIZE, 0, LIST_HEAD_INIT(stack_pools[3].free) },
+};
+
+/* kept at the bottom of a pooled stack */
+struct pooled_stack {
+	struct list_head	list;
+	unsigned long		used;	/* high-water mark when it was freed */
+};
+
+/* tasks that exited detached, waiting for the reaper */
+static LIST_HEAD(zombie_list);
+static struct semaphore	 reaper_sem = __SEMAPHORE_INITIALIZER(reaper_sem, 0);
+
+/* the next free pid after the last one handed out, so pids are not reused at once */
+static int pid_alloc(void)
+{
+	int	 pid;
+	int	 i;
+
+	enter_critical_section();
+	for (i = 0; i < PID_MAX; i++)
+	{
+		pid = (pid_last + 1 + i) % PID_MAX;
+		if (~0UL == pid_map[pid / 32])
+		{
+			/* full word, go on with the first pid of the next one */
+			i += 31 - (pid % 32);
+			continue;
+		}
+		if (!(pid_map[pid / 32] & (1UL << (pid % 32))))
+		{
+			pid_map[pid / 32] |= 1UL << (pid % 32);
+			pid_last = pid;
+			exit_critical_section();
+			return pid;
+		}
+	}
+	exit_critical_section();
+
+	return -1;
+}
+
+static void pid_free(int pid)
+{
+	enter_critical_section();
+	pid_map[pid / 32] &= ~(1UL << (pid % 32));
+	exit_critical_section();
+}
+
+static task_t *task_struct_alloc(void)
+{
+	task_t *task = NULL;
+
+	enter_critical_section();
+	if (!list_empty(&task_pool))
+	{
+		task = list_first_entry(&task_pool, task_t, task_list);
+		list_del(&task->task_list);
+		task_pool_count--;
+	}
+	exit_critical_section();
+
+	if (NULL == task)
+	{
+		task = (task_t *)kmalloc(sizeof(task_t));
+	}
+
+	return task;
+}
+
+static void task_struct_free(task_t *task)
+{
+	enter_critical_section();
+	if (task_pool_count < TASK_POOL_DEPTH)
+	{
+		list_add(&task->task_list, &task_pool);
+		task_pool_count++;
+		task = NULL;
+	}
+	exit_critical_section();
+
+	kfree(task);
+}
+
+static struct stack_pool *stack_pool_find(unsigned int size)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(stack_pools) / sizeof(stack_pools[0]); i++)
+	{
+		if (stack_pools[i].size == size)
+		{
+			return &stack_pools[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void task_stack_paint(unsigned int *p, unsigned long bytes)
+{
+	unsigned int *end = p + bytes / sizeof(*p);
+
+	while (p < end)
+	{
+		*p++ = STACK_MAGIC;
+	}
+}
+
+/*
+ * Stacks are painted with STACK_MAGIC when they are created, the deepest
+ * word that no longer holds it is the task's high-water mark. With
+ * CONFIG_STACK_GUARD the page below each stack is unmapped as well.
+ */
+static unsigned int *task_stack_alloc(unsigned int size)
+{
+	struct stack_pool	*pool = stack_pool_find(size);
+	struct pooled_stack	*ps   = NULL;
+	unsigned int		*stack;
+	unsigned long		 used;
+
+	if (pool)
+	{
+		enter_critical_section();
+		if (!list_empty(&pool->free))
+		{
+			ps = list_first_entry(&pool->free, struct pooled_stack, list);
+			list_del(&ps->list);
+			pool->count--;
+		}
+		exit_critical_section();
+	}
+
+	if (ps)
+	{
+		/* only what was written since it was last painted */
+		stack = (unsigned int *)ps;
+		used  = ps->used;
+		task_stack_paint(stack + (size - used) / sizeof(*stack), used);
+		task_stack_paint(stack, sizeof(*ps));
+		return stack;
+	}
+
+	/*
+	 * Whole pages straight from the page allocator: kmalloc() would add
+	 * its slob header and take an 8KB stack up to a 16KB block.
+	 */
+	#ifdef CONFIG_STACK_GUARD
+	stack = (unsigned int *)slob_new_pages(size + PAGE_SIZE);
+	if (NULL == stack)
+	{
+		return NULL;
+	}
+	arch_task_guard_stack(stack);
+	stack += PAGE_SIZE / sizeof(*stack);
+	#else
+	if (size >= PAGE_SIZE)
+	{
+		stack = (unsigned int *)slob_new_pages(size);
+	}
+	else
+	{
+		stack = (unsigned int *)kmalloc(size);
+	}
+	if (NULL == stack)
+	{
+		return NULL;
+	}
+	#endif
+
+	task_stack_paint(stack, size);
+
+	return stack;
+}
+
+static void task_stack_free(task_t *task)
+{
+	struct stack_pool	*pool;
+	struct pooled_stack	*ps;
+	unsigned int		*stack = task->stack;
+
+	if (NULL == stack)
+	{
+		return;
+	}
+
+	pool = stack_pool_find(task->stack_size);
+	if (pool)
+	{
+		ps	 = (struct pooled_stack *)stack;
+		ps->used = task_stack_used(task);
+
+		enter_critical_section();
+		if (pool->count < STACK_POOL_DEPTH)
+		{
+			list_add(&ps->list, &pool->free);
+			pool->count++;
+			stack = NULL;
+		}
+		exit_critical_section();
+
+		if (NULL == stack)
+		{
+			return;
+		}
+	}
+
+	#ifdef CONFIG_STACK_GUARD
+	stack -= PAGE_SIZE / sizeof(*stack);
+	arch_task_unguard_stack(stack);
+	#endif
+	kfree(stack);
+}
+
+/* deepest the task's stack has ever been, in bytes */
+unsigned long task_stack_used(task_t *task)
+{
+	unsigned int	*p;
+	unsigned int	*end;
+
+	if (NULL == task->stack)
+	{
+		return 0;
+	}
+
+	end = (unsigned int *)task->stack + task->stack_size / sizeof(*p);
+	for (p = (unsigned int *)task->stack; p < end && STACK_MAGIC == *p; p++)
+		;
+
+	return (unsigned long)end - (unsigned long)p;
+}
 
 void initial_task_func(void)
 {
@@ -53,29 +314,57 @@ void initial_task_func(void)
 	task_exit(ret);
 }
 
+/* a zeroed control block, given a pid and put on task_list */
+static int task_struct_init(task_t *task, const char *name, int stack_size, unsigned int priority)
+{
+	memset(task, 0, sizeof(task_t));
+	memcpy(task->name, name, strlen(name) + 1);
+	task->pid	 = pid_alloc();
+	if (task->pid < 0)
+	{
+		return -1;
+	}
+	task->stack_size = stack_size;
+	task->priority   = priority;
+	task->base_priority = priority;
+	/* not runnable until task_start(), sched_set_priority() may look */
+	INIT_LIST_HEAD(&task->list);
+	INIT_LIST_HEAD(&task->held_mutexes);
+	init_timer_value(&task->sleep_timer);
+	task->mm.pgd	 = kernel_pgd;
+	task->sched_class = &sched_class_fifo;
+	task->start_time = current_time_hires();
+	//task->mm.pgd	 = kmalloc(PAGE_SIZE * 4);
+	//memcpy((void *)task->mm.pgd, (void *)kernel_pgd, PAGE_SIZE * 4);
+
+	enter_critical_section();
+	list_add_tail(&task->task_list, &task_list);
+	exit_critical_section();
+
+	return 0;
+}
+
 task_t *task_alloc(char *name, int stack_size, unsigned int priority)
 {
 	task_t *task;
 
-	if (NULL == name || priority >= MAX_PRIORITY)
+	if (NULL == name || priority >= IDLE_PRIORITY)
 	{
 		return NULL;
 	}
 
-	task = (task_t *)kmalloc(sizeof(task_t));
+	task = task_struct_alloc();
 	if (task == (task_t *)0)
 	{
 		printk("Alloc task_t error!\n");
 		return NULL;
 	}
-	memset(task, 0, sizeof(task_t));
-	memcpy(task->name, name, strlen(name) + 1);
-	task->pid	 = pid++;
-	task->stack_size = stack_size;
-	task->priority   = priority;
-	task->mm.pgd	 = kernel_pgd;
-	//task->mm.pgd	 = kmalloc(PAGE_SIZE * 4);
-	//memcpy((void *)task->mm.pgd, (void *)kernel_pgd, PAGE_SIZE * 4);
+	if (task_struct_init(task, name, stack_size, priority))
+	{
+		printk("No free pid!\n");
+		task_struct_free(task);
+		return NULL;
+	}
 
 	return task;
 }
@@ -87,9 +376,31 @@ void task_free(task_t *task)
 		assert(NULL == task);
 		return;
 	}
-	
-	kfree(task->stack);
-	kfree(task);
+
+	enter_critical_section();
+	list_del(&task->task_list);
+	exit_critical_section();
+
+	pid_free(task->pid);
+	if (task->flags & TASK_STATIC)
+	{
+		return;
+	}
+	task_stack_free(task);
+	task_struct_free(task);
+}
+
+static void task_start(task_t *task, unsigned int *stack_addr, task_routine entry, void *args)
+{
+	task->stack      = stack_addr;
+	task->entry      = entry;
+	task->args	 = args;
+	task->state      = CREATING;
+
+	arch_task_initialize(task);
+	INIT_LIST_HEAD(&task->list);
+
+	sched_enqueue_task(task, ENQUEUE_WAKEUP);
 }
 
 int task_create(task_t *task, task_routine entry, void *args)
@@ -101,22 +412,14 @@ int task_create(task_t *task, task_routine entry, void *args)
 		task->stack_size = STACK_DEF_SIZE;
 	}
 
-	stack_addr = (unsigned int *)kmalloc(task->stack_size);
+	stack_addr = task_stack_alloc(task->stack_size);
 	if (stack_addr == NULL)
 	{
 		assert(stack_addr == NULL);
 		return -1;
 	}
 
-	task->stack      = stack_addr;
-	task->entry      = entry;
-	task->args	 = args;
-	task->state      = CREATING;
-
-	arch_task_initialize(task);
-	INIT_LIST_HEAD(&task->list);
-
-	scheduler->enqueue_task(task, 0);
+	task_start(task, stack_addr, entry, args);
 
 	return 0;
 }
@@ -126,7 +429,8 @@ void task_schedule(void)
 	task_t              *new_task;
 	task_t              *old_task = current_task;
 
-	new_task = scheduler->pick_next_task();
+	need_resched = 0;
+	new_task = sched_pick_next_task();
 
 	if ((NULL == new_task) || (old_task == new_task))
 	{
@@ -136,117 +440,371 @@ void task_schedule(void)
 	arch_context_switch(old_task, new_task);
 }
 
+/*
+ * Switch straight to next, which the caller has made runnable, without
+ * asking the classes. For handoffs where the caller knows who should
+ * run; a pending need_resched still applies once next leaves its
+ * critical section.
+ */
+void task_switch_to(task_t *next)
+{
+	task_t *prev = current_task;
+
+	if (prev == next)
+	{
+		return;
+	}
+
+	next->state  = RUNNING;
+	current_task = next;
+	arch_context_switch(prev, next);
+}
+
+/*
+ * Honour need_resched, called with only the outermost critical section
+ * held: by exit_critical_section() and on interrupt return. Softirqs
+ * and nested interrupts leave it to whoever they interrupted.
+ */
+void preempt_schedule(void)
+{
+	if (in_interrupt() || (NULL == current_task))
+	{
+		return;
+	}
+
+	task_schedule();
+}
+
 static enum handler_return task_sleep_function(timer_t *timer, unsigned long now, void *arg)
 {
 	task_t *t = (task_t *)arg;
 
 	dbg("%s wakeup\n", t->name);
 
-	t->state = READY;
-
 	enter_critical_section();
 
-	scheduler->enqueue_task(t, 0);
-	kfree((void *)timer);
+	/* schedule_timeout() sleepers may have been woken up already */
+	if (SLEEPING == t->state)
+	{
+		t->state = READY;
+		sched_enqueue_task(t, ENQUEUE_WAKEUP);
+		sched_check_preempt(t);
+	}
 
 	exit_critical_section();
 
-	return INT_RESCHEDULE;
+	return INT_NO_RESCHEDULE;
 }
 
-void task_sleep(unsigned long delay)
+/* sleep on the task's own timer until expires, or up to slack ms later */
+static void task_sleep_ms_slack(unsigned long expires, unsigned long slack)
 {
-	timer_t         *timer;
-	
-	dbg("start sleep ...\n");
+	unsigned long now = (unsigned long)current_time();
 
-	#ifdef DEBUG
-	scheduler->dump();
-	#endif
-	
-	timer = (timer_t *)kmalloc(sizeof(*timer));
-	if (NULL == timer)
+	if ((signed long)(expires - now) <= 0)
 	{
-		error("%s: alloc timer failled\n");
+		return;
 	}
-	
-	init_timer_value(timer);
 
 	enter_critical_section();
 
-	oneshot_timer_add(timer, delay, (timer_function)task_sleep_function, (void *)current_task);
+	timer_set_slack(&current_task->sleep_timer, slack);
+	oneshot_timer_add(&current_task->sleep_timer, expires - now,
+			  (timer_function)task_sleep_function, (void *)current_task);
 	current_task->state = SLEEPING;
 
-	scheduler->dequeue_task(current_task, 0);
+	sched_dequeue_task(current_task, 0);
 
 	task_schedule();
 	exit_critical_section();
-	
 }
 
-void task_create_init(void)
+/* sleep on the task's own timer until current_time() reaches expires */
+void task_sleep_ms_until(unsigned long expires)
 {
-	unsigned int	*stack_addr;
-	task_t		*init;
+	task_sleep_ms_slack(expires, 0);
+}
 
-	init = (task_t *)kmalloc(sizeof(task_t));
-	if (init == (task_t *)0)
+/*
+ * Sleep for delay ms, or up to slack ms more if that lets the wakeup be
+ * shared with other timers. For sleepers that only need to run "about
+ * every so often", so that the CPU can stay idle longer.
+ */
+void task_sleep_slack(unsigned long delay, unsigned long slack)
+{
+	if (0 == delay)
 	{
-		error("Alloc task_t error!\n");
-		return;
+		delay = 1;
 	}
 
-	stack_addr = (unsigned int *)kmalloc(STACK_DEF_SIZE);
-	if (stack_addr == NULL)
+	task_sleep_ms_slack((unsigned long)current_time() + delay, slack);
+}
+
+void task_sleep(unsigned long delay)
+{
+	dbg("start sleep ...\n");
+
+	#ifdef DEBUG
+	sched_dump();
+	#endif
+
+	if (0 == delay)
 	{
-		kfree(init);
+		delay = 1;
+	}
+
+	task_sleep_ms_until((unsigned long)current_time() + delay);
+}
+
+/*
+ * Sleep until current_time_hires() reaches deadline (us). The timer
+ * interrupt gets us to the last millisecond boundary before it, the
+ * rest is busy-waited.
+ */
+void task_sleep_until(unsigned long long deadline)
+{
+	task_sleep_ms_until((unsigned long)(deadline / 1000));
+
+	while (current_time_hires() < deadline)
+		;
+}
+
+void task_usleep(unsigned long usecs)
+{
+	task_sleep_until(current_time_hires() + usecs);
+}
+
+/* init runs on from the boot code, its storage is static like TASK_DEFINE()'s */
+static task_t		 init_task;
+static unsigned int	 init_stack[STACK_DEF_SIZE / sizeof(unsigned int)] __aligned(8);
+
+static void task_create_init(void)
+{
+	task_t		*init = &init_task;
+
+	if (task_struct_init(init, INIT_TASK_NAME, STACK_DEF_SIZE, IDLE_PRIORITY))
+	{
+		error("No free pid for init!\n");
 		return;
 	}
 
-	init->sp         = (unsigned int)stack_addr + STACK_DEF_SIZE;
-	init->stack_size = STACK_DEF_SIZE;
-	init->priority	 = MAX_PRIORITY-1;
+	init->sp         = (unsigned int)init_stack + STACK_DEF_SIZE;
+	init->flags	 = TASK_STATIC;
 	init->state      = CREATING;
-	init->mm.pgd	 = kernel_pgd;
-	memcpy(init->name, INIT_TASK_NAME, strlen(INIT_TASK_NAME) + 1);
+	init->last_run	 = init->start_time;
 
 	INIT_LIST_HEAD(&init->list);
 
-	scheduler->enqueue_task(init, 0);
+	sched_enqueue_task(init, 0);
 
 	current_task = init;
 }
 
+extern const struct task_static __task_static_start[];
+extern const struct task_static __task_static_end[];
+
+/* start the TASK_DEFINE() tasks, in link order */
+static void task_static_init(void)
+{
+	const struct task_static *ts;
+
+	for (ts = __task_static_start; ts < __task_static_end; ts++)
+	{
+		if (task_struct_init(ts->task, ts->name, ts->stack_size, ts->priority))
+		{
+			error("No free pid for %s!\n", ts->name);
+			continue;
+		}
+		ts->task->flags = TASK_STATIC;
+		task_stack_paint(ts->stack, ts->stack_size);
+		task_start(ts->task, ts->stack, ts->entry, NULL);
+	}
+}
+
 void task_init(void)
 {
 	sched_init();
+	task_create_init();
+	task_static_init();
+}
+
+task_t *task_find_by_pid(int pid)
+{
+	task_t *task;
+
+	list_for_each_entry(task, &task_list, task_list) {
+		if (task->pid == pid) {
+			return task;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Called by arch_context_switch() right before the switch: charge prev
+ * for the time it ran and start the clock for next. A task that leaves
+ * the cpu while still RUNNING was preempted.
+ */
+void task_account_switch(task_t *prev, task_t *next)
+{
+	unsigned long long now = current_time_hires();
+
+	task_group_charge(prev, now, (unsigned long)(now - prev->last_run));
+	prev->runtime += now - prev->last_run;
+	if (RUNNING == prev->state) {
+		prev->nivcsw++;
+	}
+	else {
+		prev->nvcsw++;
+	}
+
+	next->last_run = now;
+	if (next->wakeup_time) {
+		next->wakeup_latency = (unsigned long)(now - next->wakeup_time);
+		if (next->wakeup_latency > next->wakeup_latency_max) {
+			next->wakeup_latency_max = next->wakeup_latency;
+		}
+		next->wakeup_time = 0;
+	}
+}
+
+/* bring the running task's runtime up to date, from the tick */
+void task_account_tick(task_t *task)
+{
+	unsigned long long now = current_time_hires();
+
+	task_group_charge(task, now, (unsigned long)(now - task->last_run));
+	task->runtime += now - task->last_run;
+	task->last_run = now;
 }
 
 void task_exit(int retcode)
 {
+	/* give its frames and bandwidth back before the task_t can be reused */
+	task_set_cyclic(current_task, CYCLIC_IDLE);
+	task_periodic_exit(current_task);
+	task_group_attach(current_task, NULL);
+
 	enter_critical_section();
 
 	current_task->state = EXITED;
 	current_task->ret   = retcode;
 
 	#ifdef DEBUG
-	scheduler->dump();
+	sched_dump();
 	#endif
 
-	scheduler->dequeue_task(current_task, 0);
+	sched_dequeue_task(current_task, 0);
+
+	if (current_task->flags & TASK_DETACHED)
+	{
+		/* can't free the stack we are running on, leave it to the reaper */
+		list_add_tail(&current_task->list, &zombie_list);
+		up(&reaper_sem);
+	}
+	else if (current_task->joiner)
+	{
+		current_task->joiner->state = READY;
+		sched_enqueue_task(current_task->joiner, ENQUEUE_WAKEUP);
+	}
 
 	task_schedule();
 }
 
-static int try_to_wake_up(task_t *t)
+/*
+ * Wait for task to exit, collect its exit code and free it. Only one
+ * task may join a task, and not one that has been detached.
+ */
+int task_join(task_t *task, int *retcode)
 {
-	t->state = READY;
+	if ((NULL == task) || (task == current_task))
+	{
+		return -1;
+	}
 
 	enter_critical_section();
 
-	scheduler->enqueue_task(t, 0);
-	task_schedule();
-	
+	if ((task->flags & TASK_DETACHED) || task->joiner)
+	{
+		exit_critical_section();
+		return -1;
+	}
+
+	while (EXITED != task->state)
+	{
+		task->joiner = current_task;
+		current_task->state = BLOCKED;
+		sched_dequeue_task(current_task, 0);
+		task_schedule();
+	}
+
+	exit_critical_section();
+
+	if (retcode)
+	{
+		*retcode = task->ret;
+	}
+	task_free(task);
+
+	return 0;
+}
+
+/* nobody is going to join task, have the reaper free it once it exits */
+int task_detach(task_t *task)
+{
+	if (NULL == task)
+	{
+		return -1;
+	}
+
+	enter_critical_section();
+	if (task->joiner)
+	{
+		exit_critical_section();
+		return -1;
+	}
+	task->flags |= TASK_DETACHED;
+	if (EXITED == task->state)
+	{
+		list_add_tail(&task->list, &zombie_list);
+		up(&reaper_sem);
+	}
+	exit_critical_section();
+
+	return 0;
+}
+
+static int task_reaper(void *arg)
+{
+	task_t *task;
+
+	while (1)
+	{
+		down(&reaper_sem);
+
+		enter_critical_section();
+		task = list_first_entry(&zombie_list, task_t, list);
+		list_del_init(&task->list);
+		exit_critical_section();
+
+		task_free(task);
+	}
+
+	return 0;
+}
+
+TASK_DEFINE(reaper, REAPER_PRIORITY, 0x400, task_reaper);
+
+static int try_to_wake_up(task_t *t)
+{
+	enter_critical_section();
+
+	t->state = READY;
+	sched_enqueue_task(t, ENQUEUE_WAKEUP);
+	/* the switch, if any, happens once the waker leaves its critical section */
+	sched_check_preempt(t);
+
 	exit_critical_section();
 
 	return 0;
@@ -257,17 +815,27 @@ int default_wake_function(wait_queue_t *curr)
 	return try_to_wake_up(curr->private);
 }
 
+/*
+ * Sleep until woken up or timeout ticks have passed, returns the ticks
+ * that were left. The caller has set its state already; if a wakeup
+ * came in before we got here (state is READY again) don't sleep at all.
+ */
 signed long schedule_timeout(signed long timeout)
 {
-	timer_t         *timer;
 	unsigned long expire;
 
 	switch (timeout)
 	{
 	case MAX_SCHEDULE_TIMEOUT:
-		current_task->state = SLEEPING;
-		scheduler->dequeue_task(current_task, 0);
-		task_schedule();
+		enter_critical_section();
+		if (READY != current_task->state)
+		{
+			current_task->state = SLEEPING;
+			sched_dequeue_task(current_task, 0);
+			task_schedule();
+		}
+		current_task->state = RUNNING;
+		exit_critical_section();
 		goto out;
 	default:
 		if (timeout < 0) {
@@ -280,7 +848,21 @@ signed long schedule_timeout(signed long timeout)
 
 	expire = timeout + current_time();
 
-	task_sleep(expire);
+	enter_critical_section();
+	if (READY != current_task->state)
+	{
+		timer_set_slack(&current_task->sleep_timer, 0);
+		oneshot_timer_add(&current_task->sleep_timer, timeout,
+				  (timer_function)task_sleep_function, (void *)current_task);
+		current_task->state = SLEEPING;
+		sched_dequeue_task(current_task, 0);
+		task_schedule();
+
+		/* woken up before the timer went off */
+		timer_delete(&current_task->sleep_timer);
+	}
+	current_task->state = RUNNING;
+	exit_critical_section();
 
 	timeout = expire - current_time();
 
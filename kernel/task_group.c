@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include <kernel/task.h>
+#include <kernel/printk.h>
+#include <kernel/types.h>
+#include <kernel/sched.h>
+#include <kernel/timer.h>
+
+//#define DEBUG           1
+#include <kernel/debug.h>
+
+/*
+ * CPU reservations for groups of FIFO tasks, run as a simple sporadic
+ * server: the budget starts being used at some time t, and whatever
+ * was used comes back at t + period. A group that used up its budget
+ * is throttled: sched_fifo_pick_next_task() parks its tasks on the
+ * group's throttled list until the replenishment timer puts them back.
+ * Tasks without a group are not limited.
+ */
+struct task_group	 task_groups[TASK_GROUP_MAX];
+
+static handler_return task_group_replenish(timer_t *timer, unsigned long now, void *arg)
+{
+	struct task_group	*group = arg;
+	task_t			*p, *n;
+
+	enter_critical_section();
+
+	group->throttled_time += current_time_hires() - group->throttled_since;
+	group->remaining       = group->budget;
+	group->flags	      &= ~(TG_ARMED | TG_THROTTLED);
+
+	list_for_each_entry_safe(p, n, &group->throttled, list) {
+		list_del_init(&p->list);
+		sched_enqueue_task(p, 0);
+		sched_check_preempt(p);
+	}
+
+	exit_critical_section();
+
+	return INT_NO_RESCHEDULE;
+}
+
+/*
+ * Charge delta microseconds of cpu, ending at now, to the group of a
+ * fifo task. Called with interrupts disabled on every context switch
+ * and tick.
+ */
+void task_group_charge(task_t *p, unsigned long long now, unsigned long delta)
+{
+	struct task_group	*group = p->group;
+	unsigned long		 wait;
+
+	if ((NULL == group) || (p->sched_class != &sched_class_fifo)) {
+		return;
+	}
+
+	group->runtime += delta;
+
+	if (group->flags & TG_THROTTLED) {
+		return;
+	}
+
+	/* a whole period since the budget started being used, it is all back */
+	if ((group->flags & TG_ARMED) && (now >= group->replenish_at)) {
+		group->remaining = group->budget;
+		group->flags	&= ~TG_ARMED;
+	}
+
+	if (!(group->flags & TG_ARMED)) {
+		group->flags	    |= TG_ARMED;
+		group->replenish_at  = now - delta + group->period;
+	}
+
+	group->remaining -= delta;
+	if (group->remaining > 0) {
+		return;
+	}
+
+	group->flags	       |= TG_THROTTLED;
+	group->nr_throttled++;
+	group->throttled_since	= now;
+
+	wait = (now < group->replenish_at) ?
+		(unsigned long)((group->replenish_at - now + 999) / 1000) : 1;
+	oneshot_timer_add(&group->timer, wait, (timer_function)task_group_replenish, group);
+
+	dbg("group %s throttled for %d ms\n", group->name, (int)wait);
+}
+
+/* called by the fifo class for a runnable task of a throttled group */
+void task_group_park(task_t *p)
+{
+	list_add_tail(&p->list, &p->group->throttled);
+}
+
+static int task_group_valid(unsigned long budget, unsigned long period)
+{
+	return (0 != budget) && (0 != period) && (budget <= period);
+}
+
+/*
+ * Reserve budget microseconds of cpu every period microseconds for the
+ * tasks that will be attached to the group.
+ */
+struct task_group *task_group_create(const char *name, unsigned long budget,
+				     unsigned long period)
+{
+	struct task_group	*group = NULL;
+	int			 i;
+
+	if ((NULL == name) || ('\0' == *name) || !task_group_valid(budget, period)) {
+		return NULL;
+	}
+
+	enter_critical_section();
+
+	if (NULL != task_group_find(name)) {
+		exit_critical_section();
+		return NULL;
+	}
+
+	for (i = 0; i < TASK_GROUP_MAX; i++) {
+		if ('\0' == task_groups[i].name[0]) {
+			group = &task_groups[i];
+			break;
+		}
+	}
+
+	if (NULL != group) {
+		memset(group, 0, sizeof(*group));
+		strncpy(group->name, name, sizeof(group->name) - 1);
+		group->budget	 = budget;
+		group->period	 = period;
+		group->remaining = budget;
+		INIT_LIST_HEAD(&group->throttled);
+		init_timer_value(&group->timer);
+	}
+
+	exit_critical_section();
+
+	return group;
+}
+
+struct task_group *task_group_find(const char *name)
+{
+	int i;
+
+	for (i = 0; i < TASK_GROUP_MAX; i++) {
+		if (('\0' != task_groups[i].name[0]) &&
+		    (0 == strncmp(task_groups[i].name, name, sizeof(task_groups[i].name)))) {
+			return &task_groups[i];
+		}
+	}
+
+	return NULL;
+}
+
+/* takes effect from the next replenishment */
+int task_group_set(struct task_group *group, unsigned long budget, unsigned long period)
+{
+	if ((NULL == group) || !task_group_valid(budget, period)) {
+		return -1;
+	}
+
+	enter_critical_section();
+	group->budget = budget;
+	group->period = period;
+	if (!(group->flags & TG_THROTTLED) && (group->remaining > (long)budget)) {
+		group->remaining = budget;
+	}
+	exit_critical_section();
+
+	return 0;
+}
+
+int task_group_destroy(struct task_group *group)
+{
+	if ((NULL == group) || group->nr_tasks) {
+		return -1;
+	}
+
+	timer_delete(&group->timer);
+
+	enter_critical_section();
+	group->name[0] = '\0';
+	exit_critical_section();
+
+	return 0;
+}
+
+/* move a task into group, or out of any group if group is NULL */
+int task_group_attach(task_t *task, struct task_group *group)
+{
+	int queued;
+
+	if (NULL == task) {
+		return -1;
+	}
+
+	if (task->group == group) {
+		return 0;
+	}
+
+	enter_critical_section();
+
+	queued = !list_empty(&task->list);
+	if (queued) {
+		sched_dequeue_task(task, 0);
+	}
+
+	if (NULL != task->group) {
+		task->group->nr_tasks--;
+	}
+	task->group = group;
+	if (NULL != group) {
+		group->nr_tasks++;
+	}
+
+	if (queued) {
+		sched_enqueue_task(task, 0);
+	}
+
+	exit_critical_section();
+
+	return 0;
+}
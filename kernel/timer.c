@@ -25,75 +25,481 @@
 #include <arch/interrupts.h>
 #include <kernel/timer.h>
 #include <kernel/task.h>
+#include <kernel/semaphore.h>
+#include <kernel/sched.h>
 #include <kernel/printk.h>
+#include <kernel/irq.h>
+#include <kernel/bitops.h>
+#include <arch/platform.h>
+#include <arch/arch.h>
 
 //#define DEBUG    1
 #include <kernel/debug.h>
 
-struct list_head timer_list;
+/*
+ * Pending timers sit in a hierarchical timing wheel. The root has a slot
+ * for each of the next 256 ms, each of the four levels above it 64 slots
+ * of 256, 16384, ... ms, enough for any 32-bit delay. Adding and deleting
+ * a timer is O(1); when the root wraps, the next slot of the level above
+ * is cascaded down into it, and so on up. wheel_clk is the first ms the
+ * wheel has not run yet. A bit per slot, set on add and cleared once the
+ * slot is found empty, lets the clock skip over empty slots after a long
+ * tickless idle. Due timers wait on timer_expired for the softirq.
+ */
+#define WHEEL_ROOT_BITS		8
+#define WHEEL_LVL_BITS		6
+#define WHEEL_ROOT_SIZE		(1 << WHEEL_ROOT_BITS)
+#define WHEEL_LVL_SIZE		(1 << WHEEL_LVL_BITS)
+#define WHEEL_ROOT_MASK		(WHEEL_ROOT_SIZE - 1)
+#define WHEEL_LVL_MASK		(WHEEL_LVL_SIZE - 1)
+#define WHEEL_LEVELS		4
+#define WHEEL_LVL_SHIFT(lvl)	(WHEEL_ROOT_BITS + (lvl) * WHEEL_LVL_BITS)
 
-static void dump_timers(void)
+/* slot s is bit s of the map, counted from the msb as in sched_fifo */
+#define SLOT_WORD(s)		((s) / BITS_PER_LONG)
+#define SLOT_BIT(s)		(BITS_PER_LONG - 1 - ((s) % BITS_PER_LONG))
+
+static struct list_head	 wheel_root[WHEEL_ROOT_SIZE];
+static struct list_head	 wheel_lvl[WHEEL_LEVELS][WHEEL_LVL_SIZE];
+static unsigned long	 wheel_root_map[WHEEL_ROOT_SIZE / BITS_PER_LONG];
+static unsigned long	 wheel_lvl_map[WHEEL_LEVELS][WHEEL_LVL_SIZE / BITS_PER_LONG];
+static unsigned long	 wheel_clk;
+
+static LIST_HEAD(timer_expired);
+static unsigned int	 timer_count;		/* in the wheel or on timer_expired */
+static unsigned long	 timer_next;		/* earliest expiry, if timer_next_valid */
+static int		 timer_next_valid;
+
+/*
+ * Soft timers are run by the timer task instead of the softirq, so
+ * what their functions do cannot hold up interrupts. The softirq is the
+ * only one to fill timer_soft_ring and the timer task the only one to
+ * empty it, each moving its own index, so the tick side never waits on
+ * the task. A soft timer due while the ring is full is put off a ms.
+ *
+ * The EDF class runs ahead of every FIFO priority, so a FIFO timer task
+ * could be starved by deadline tasks. It makes itself a sporadic
+ * deadline task instead: each wakeup must be served within
+ * TIMER_TASK_DEADLINE ms, and it competes with the other deadline
+ * tasks on that. The owner of a cyclic frame still runs first.
+ */
+#define TIMER_SOFT_RING		64
+#define TIMER_TASK_PRIORITY	4	/* only until timer_task() starts */
+#define TIMER_TASK_DEADLINE	(1000 / HZ)	/* ms, one tick */
+
+struct timer_soft_entry {
+	timer_t		*timer;		/* NULL once timer_delete() cancelled it */
+	unsigned long	 now;
+};
+
+static struct timer_soft_entry	 timer_soft_ring[TIMER_SOFT_RING];
+static volatile unsigned int	 timer_soft_head;	/* next to fill, softirq only */
+static volatile unsigned int	 timer_soft_tail;	/* next to run, timer task only */
+static struct semaphore		 timer_soft_wakeup =
+	__SEMAPHORE_INITIALIZER(timer_soft_wakeup, 0);
+
+/*
+ * Scheduler ticks keep to a grid of TICK_NSEC from the first one. The
+ * interrupts the one-shot timer raises in between for timers are not
+ * ticks, see timer_tick_boundary().
+ */
+#define TICK_NSEC		(NSEC_PER_SEC / HZ)
+
+static unsigned long long tick_next_ns;
+
+struct timer_stats timer_stats;
+struct idle_stats idle_stats;
+
+#ifdef CONFIG_TICKLESS
+int tickless_enabled = 1;
+
+/* not worth stopping the tick for less than this many ms */
+#define TICKLESS_MIN_IDLE	(2 * 1000 / HZ)
+#endif
+
+static void dump_slot(struct list_head *slot)
 {
 	timer_t *timer;
 
-	printk("all timers:\n");
-	list_for_each_entry(timer, &timer_list, entry)
+	list_for_each_entry(timer, slot, entry)
+	{
+		printk(" timer: 0x%x %d ", (unsigned int)timer, timer->expired_time);
+	}
+}
+
+static void dump_timers(void)
+{
+	int lvl, i;
+
+	printk("all timers, clk %d:\n", wheel_clk);
+	dump_slot(&timer_expired);
+	for (i = 0; i < WHEEL_ROOT_SIZE; i++)
+	{
+		dump_slot(&wheel_root[i]);
+	}
+	for (lvl = 0; lvl < WHEEL_LEVELS; lvl++)
 	{
-		printk(" %s timer: 0x%x %d ",
-		       ((task_t *)(timer->arg))->name,
-		       (unsigned int)timer, timer->expired_time);
+		for (i = 0; i < WHEEL_LVL_SIZE; i++)
+		{
+			dump_slot(&wheel_lvl[lvl][i]);
+		}
 	}
 	printk("\n");
 }
 
-static void timer_list_add(timer_t *timer)
+/* first slot in [from, to) with its bit set, to if there is none */
+static unsigned int wheel_find(unsigned long *map, unsigned int from, unsigned int to)
 {
-	timer_t *iterator;
+	unsigned long bits;
 
-	dbg("Etime:%d\n", timer->expired_time);
-	#ifdef DEBUG
-	dump_timers();
-	#endif
+	while (from < to)
+	{
+		bits = map[SLOT_WORD(from)] & (~0UL >> (from % BITS_PER_LONG));
+		if (bits)
+		{
+			from = SLOT_WORD(from) * BITS_PER_LONG + __clz(bits);
+			return (from < to) ? from : to;
+		}
+		from = (SLOT_WORD(from) + 1) * BITS_PER_LONG;
+	}
+
+	return to;
+}
 
-	if (list_empty(&timer_list))
+/* as wheel_find(), clearing the bits of slots that have emptied */
+static unsigned int wheel_first(unsigned long *map, struct list_head *slots,
+				unsigned int from, unsigned int to)
+{
+	while ((from = wheel_find(map, from, to)) < to)
+	{
+		if (!list_empty(&slots[from]))
+		{
+			break;
+		}
+		clear_bit(SLOT_BIT(from), &map[SLOT_WORD(from)]);
+		from++;
+	}
+
+	return from;
+}
+
+static void wheel_add(timer_t *timer)
+{
+	unsigned long	 expires = timer->expired_time;
+	unsigned long	 delta	 = expires - wheel_clk;
+	unsigned int	 idx;
+	int		 lvl;
+
+	if ((signed long)delta < 0)
 	{
-		list_add(&timer->entry, &timer_list);
+		/* already due, goes with the next ms the wheel runs */
+		expires = wheel_clk;
+		delta	= 0;
+	}
+
+	if (delta < WHEEL_ROOT_SIZE)
+	{
+		idx = expires & WHEEL_ROOT_MASK;
+		list_add_tail((struct list_head *)&timer->entry, &wheel_root[idx]);
+		set_bit(SLOT_BIT(idx), &wheel_root_map[SLOT_WORD(idx)]);
 		return;
 	}
 
-	list_for_each_entry(iterator, &timer_list, entry)
+	for (lvl = 0; lvl < WHEEL_LEVELS - 1; lvl++)
 	{
-		dbg("%d\n", iterator->expired_time);
-		if (iterator->expired_time < timer->expired_time)
+		if (delta < (1UL << WHEEL_LVL_SHIFT(lvl + 1)))
 		{
-			list_add(&timer->entry, &iterator->entry);
-			return;
+			break;
+		}
+	}
+	idx = (expires >> WHEEL_LVL_SHIFT(lvl)) & WHEEL_LVL_MASK;
+	list_add_tail((struct list_head *)&timer->entry, &wheel_lvl[lvl][idx]);
+	set_bit(SLOT_BIT(idx), &wheel_lvl_map[lvl][SLOT_WORD(idx)]);
+}
+
+/* move the current slot of lvl one level down, returns the slot index */
+static unsigned int wheel_cascade(int lvl)
+{
+	unsigned int	 idx = (wheel_clk >> WHEEL_LVL_SHIFT(lvl)) & WHEEL_LVL_MASK;
+	timer_t		*timer, *next;
+	LIST_HEAD(slot);
+
+	list_splice_init(&wheel_lvl[lvl][idx], &slot);
+	clear_bit(SLOT_BIT(idx), &wheel_lvl_map[lvl][SLOT_WORD(idx)]);
+
+	list_for_each_entry_safe(timer, next, &slot, entry)
+	{
+		wheel_add(timer);
+		timer_stats.cascaded++;
+	}
+
+	return idx;
+}
+
+/* run the wheel up to and including now, due timers go to timer_expired */
+static void wheel_advance(unsigned long now)
+{
+	unsigned int	 idx, end;
+	int		 lvl;
+
+	while ((signed long)(now - wheel_clk) >= 0)
+	{
+		idx = wheel_clk & WHEEL_ROOT_MASK;
+		if (0 == idx)
+		{
+			for (lvl = 0; lvl < WHEEL_LEVELS; lvl++)
+			{
+				if (wheel_cascade(lvl))
+				{
+					break;
+				}
+			}
+		}
+
+		/* the next pending slot of this round of the root, not past now */
+		end = WHEEL_ROOT_SIZE;
+		if (now - wheel_clk < (unsigned long)(end - idx))
+		{
+			end = idx + (now - wheel_clk) + 1;
+		}
+
+		end = wheel_find(wheel_root_map, idx, end);
+		wheel_clk += end - idx;
+		if (end == WHEEL_ROOT_SIZE || (signed long)(now - wheel_clk) < 0)
+		{
+			continue;
+		}
+
+		list_splice_tail_init(&wheel_root[end], &timer_expired);
+		clear_bit(SLOT_BIT(end), &wheel_root_map[SLOT_WORD(end)]);
+		wheel_clk++;
+	}
+}
+
+/* earliest expiry of the timers in a slot of the levels above the root */
+static unsigned long wheel_slot_first(struct list_head *slot)
+{
+	timer_t		*timer;
+	unsigned long	 first;
+
+	timer = list_first_entry(slot, timer_t, entry);
+	first = timer->expired_time;
+	list_for_each_entry(timer, slot, entry)
+	{
+		if ((signed long)(timer->expired_time - first) < 0)
+		{
+			first = timer->expired_time;
+		}
+	}
+
+	return first;
+}
+
+/*
+ * Earliest expiry in the wheel. A root slot at or after the clock's is
+ * this round, one before it the next; either way its expiry follows
+ * from the index. Each level above only needs its first pending slot
+ * after the clock's looked at, or the clock's own if it has yet to be
+ * cascaded.
+ */
+static unsigned long wheel_next(void)
+{
+	unsigned int	 idx = wheel_clk & WHEEL_ROOT_MASK;
+	unsigned int	 from, s;
+	unsigned long	 next, first;
+	int		 found = 0;
+	int		 lvl;
+
+	if (!list_empty(&timer_expired))
+	{
+		return wheel_clk - 1;
+	}
+
+	next = 0;
+	s = wheel_first(wheel_root_map, wheel_root, idx, WHEEL_ROOT_SIZE);
+	if (s < WHEEL_ROOT_SIZE)
+	{
+		/* nothing above can be due before it, unless about to cascade */
+		next  = wheel_clk + (s - idx);
+		found = 1;
+		if (idx)
+		{
+			return next;
+		}
+	}
+	else
+	{
+		s = wheel_first(wheel_root_map, wheel_root, 0, idx);
+		if (s < idx)
+		{
+			next  = wheel_clk + (WHEEL_ROOT_SIZE - idx) + s;
+			found = 1;
+		}
+	}
+
+	for (lvl = 0; lvl < WHEEL_LEVELS; lvl++)
+	{
+		/* the clock's own slot if the clock is about to cascade it */
+		from = (wheel_clk >> WHEEL_LVL_SHIFT(lvl)) & WHEEL_LVL_MASK;
+		if (wheel_clk & ((1UL << WHEEL_LVL_SHIFT(lvl)) - 1))
+		{
+			from++;
 		}
+
+		s = wheel_first(wheel_lvl_map[lvl], wheel_lvl[lvl], from, WHEEL_LVL_SIZE);
+		if (WHEEL_LVL_SIZE == s)
+		{
+			s = wheel_first(wheel_lvl_map[lvl], wheel_lvl[lvl], 0, from);
+			if (from == s)
+			{
+				continue;
+			}
+		}
+
+		first = wheel_slot_first(&wheel_lvl[lvl][s]);
+		if (!found || (signed long)(first - next) < 0)
+		{
+			next  = first;
+			found = 1;
+		}
+	}
+
+	return next;
+}
+
+/* earliest pending expiry, returns 0 if there are no timers */
+static int timer_next_expiry(unsigned long *next)
+{
+	if (0 == timer_count)
+	{
+		return 0;
+	}
+
+	if (!timer_next_valid)
+	{
+		timer_next	 = wheel_next();
+		timer_next_valid = 1;
+	}
+	*next = timer_next;
+
+	return 1;
+}
+
+/* have the hardware interrupt in time for the earliest timer */
+static void timer_program_next(void)
+{
+	unsigned long		 next;
+	unsigned long long	 now;
+
+	if (!timer_next_expiry(&next))
+	{
+		return;
+	}
+
+	now = current_time();
+	platform_timer_wakeup_at(now + (signed long)(next - (unsigned long)now));
+}
+
+static void timer_wheel_add(timer_t *timer)
+{
+	dbg("Etime:%d\n", timer->expired_time);
+
+	wheel_add(timer);
+	timer_count++;
+	timer_stats.added++;
+
+	/* a new earliest timer may be due before the next tick */
+	if (!timer_next_valid || (signed long)(timer->expired_time - timer_next) < 0)
+	{
+		timer_next = timer->expired_time;
+		timer_program_next();
 	}
-	list_add_tail(&timer->entry, &timer_list);
 
 	#ifdef DEBUG
 	dump_timers();
 	#endif
 }
 
-static void timer_add(timer_t *timer, unsigned int delay_time, unsigned int period, timer_function function, void *arg)
+static void timer_wheel_del(timer_t *timer)
+{
+	list_del_init((struct list_head *)&timer->entry);
+	if (0 == --timer_count || timer->expired_time == timer_next)
+	{
+		timer_next_valid = 0;
+	}
+}
+
+/*
+ * Where a timer with slack goes: onto the earliest pending deadline if
+ * that is within its window, else onto the time in the window with the
+ * most low bits clear, where others with slack tend to land as well.
+ */
+static unsigned long timer_slack_expiry(unsigned long expires, unsigned long slack)
+{
+	unsigned long	 limit = expires + slack;
+	unsigned long	 next;
+	unsigned long	 aligned;
+	int		 bit;
+
+	if (timer_next_expiry(&next) &&
+	    (signed long)(next - expires) >= 0 && (signed long)(limit - next) >= 0)
+	{
+		return next;
+	}
+
+	bit	= fls(expires ^ limit);
+	aligned = limit & ~((1UL << (bit - 1)) - 1);
+
+	/* limit wrapped around the ms clock */
+	if ((signed long)(aligned - expires) < 0)
+	{
+		return expires;
+	}
+
+	return aligned;
+}
+
+/* queue the timer for expires, or later within its slack */
+static void timer_queue(timer_t *timer, unsigned long expires)
+{
+	timer->requested    = expires;
+	timer->expired_time = expires;
+	if (timer->slack)
+	{
+		timer->expired_time = timer_slack_expiry(expires, timer->slack);
+		if (timer->expired_time != expires)
+		{
+			timer_stats.slack_moved++;
+		}
+	}
+
+	timer_wheel_add(timer);
+}
+
+/* drop a soft timer's expiry the timer task has not got to yet */
+static void timer_soft_cancel(timer_t *timer)
 {
-	unsigned long long now;
+	if (timer->flags & TIMER_SOFT_QUEUED)
+	{
+		timer_soft_ring[timer->soft_slot % TIMER_SOFT_RING].timer = NULL;
+		timer->flags &= ~TIMER_SOFT_QUEUED;
+	}
+}
 
+static void timer_add(timer_t *timer, unsigned int delay_time, unsigned int period, timer_function function, void *arg)
+{
 	if (!list_empty(&timer->entry))
 	{
 		error("timer has been added\n");
 	}
 	
-	now = current_time();
-	timer->expired_time = now + delay_time;
 	timer->periodic_time = period;
 	timer->function = function;
 	timer->arg = arg;
 
 	enter_critical_section();
-	timer_list_add(timer);
+	timer_soft_cancel(timer);
+	timer_queue(timer, (unsigned long)current_time() + delay_time);
 	exit_critical_section();
 }
 
@@ -123,8 +529,10 @@ void timer_delete(timer_t *timer)
 	
 	if (!list_empty(&timer->entry))
 	{
-		list_del_init(&timer->entry);
+		timer_wheel_del(timer);
+		timer_stats.deleted++;
 	}
+	timer_soft_cancel(timer);
 	timer->periodic_time = 0;
 	timer->expired_time  = 0;
 	timer->function	     = NULL;
@@ -133,57 +541,390 @@ void timer_delete(timer_t *timer)
 	exit_critical_section();
 }
 
+/* the tick boundary ahead, for the platform to keep its periodic timer on */
+unsigned long long timer_next_tick_ns(void)
+{
+	return tick_next_ns;
+}
+
+/* whether this interrupt falls on a tick boundary, moving on to the next */
+static int timer_tick_boundary(void)
+{
+	unsigned long long ns = current_time_ns();
+
+	if ((long long)(tick_next_ns - ns) > TICK_SLOP_NS)
+	{
+		return 0;
+	}
+
+	/* the tick was off while idle, catch up with the grid */
+	if ((long long)(ns - tick_next_ns) >= TICK_NSEC)
+	{
+		tick_next_ns += (ns - tick_next_ns) / TICK_NSEC * TICK_NSEC;
+	}
+	tick_next_ns += TICK_NSEC;
+
+	return 1;
+}
+
 enum handler_return timer_tick(void *arg, bigtime_t now)
 {
-	timer_t *timer;
-	timer_t *timer_tmp;
 	enum handler_return ret = INT_NO_RESCHEDULE;
+	unsigned long	    next;
 	static	 first_time     = 1;
 
+	/* keep the clocksource from wrapping, also when coming out of idle */
+	clocksource_update();
+
 	if (first_time)
 	{
-		first_time = 0;
+		first_time   = 0;
+		tick_next_ns = current_time_ns() + TICK_NSEC;
 		return INT_RESCHEDULE;
 	}
 
 	dbg("now=%d\n", now);
 
+	/* time slices and budgets are charged per tick, not per interrupt */
+	if (timer_tick_boundary() && sched_tick())
+	{
+		ret = INT_RESCHEDULE;
+	}
+
 	#ifdef DEBUG
 	dump_timers();
 	#endif
 
-	list_for_each_entry_safe(timer, timer_tmp, &timer_list, entry)
+	/* the callbacks run from the timer softirq, with interrupts enabled */
+	if (timer_next_expiry(&next) && (signed long)(next - (unsigned long)now) <= 0)
+	{
+		raise_softirq(TIMER_SOFTIRQ);
+		return ret;
+	}
+
+	timer_program_next();
+
+	return ret;
+}
+
+/*
+ * Next deadline of a periodic timer, from the one it has just had (as
+ * asked for, before any slack) so that it does not drift. Periods that
+ * went by while it waited are skipped and counted instead of run back
+ * to back.
+ */
+static void timer_rearm(timer_t *timer, unsigned long now)
+{
+	unsigned long period   = timer->periodic_time;
+	unsigned long deadline = timer->requested + period;
+
+	if ((signed long)(deadline - now) <= 0)
+	{
+		timer_stats.overruns += (now - deadline) / period + 1;
+		deadline	     += ((now - deadline) / period + 1) * period;
+	}
+
+	timer_queue(timer, deadline);
+}
+
+/*
+ * What slack saved in one pass: each distinct ms the timers asked for
+ * would have been a wakeup of its own, against the deadlines actually
+ * run. Only the first PASS_WANTED asked for ms are told apart.
+ */
+#define PASS_WANTED	16
+
+struct timer_pass {
+	unsigned long	 wanted[PASS_WANTED];
+	int		 nr_wanted;
+	unsigned long	 last;
+	int		 nr_run;
+};
+
+static void timer_pass_count(struct timer_pass *pass, timer_t *timer)
+{
+	int i;
+
+	if ((0 == pass->nr_run) || (timer->expired_time != pass->last))
 	{
-		unsigned long expired_time  = timer->expired_time;
-		unsigned long periodic_time = timer->periodic_time;
+		pass->last = timer->expired_time;
+		pass->nr_run++;
+	}
 
-		if ((signed long)(expired_time - now) > 0)
+	for (i = 0; (i < pass->nr_wanted) && (i < PASS_WANTED); i++)
+	{
+		if (pass->wanted[i] == timer->requested)
 		{
-			break;
+			return;
 		}
+	}
+	if (pass->nr_wanted < PASS_WANTED)
+	{
+		pass->wanted[pass->nr_wanted] = timer->requested;
+	}
+	pass->nr_wanted++;
+}
+
+/*
+ * Hand a due soft timer to the timer task, returns 1 if the task needs
+ * waking. One that is still queued from its last expiry runs once for
+ * both.
+ */
+static int timer_soft_queue(timer_t *timer, unsigned long now)
+{
+	unsigned int		 head = timer_soft_head;
+	struct timer_soft_entry	*e;
+
+	if (timer->flags & TIMER_SOFT_QUEUED)
+	{
+		timer_stats.overruns++;
+	}
+	else if (head - timer_soft_tail >= TIMER_SOFT_RING)
+	{
+		timer->expired_time = now + 1;
+		timer_wheel_add(timer);
+		timer_stats.soft_deferred++;
+		return 0;
+	}
+	else
+	{
+		e		  = &timer_soft_ring[head % TIMER_SOFT_RING];
+		e->timer	  = timer;
+		e->now		  = now;
+		timer->soft_slot  = head;
+		timer->flags	 |= TIMER_SOFT_QUEUED;
+		timer_stats.soft_queued++;
+
+		/* the entry before the index that lets the task see it */
+		barrier();
+		timer_soft_head = head + 1;
+	}
+
+	if (timer->periodic_time)
+	{
+		timer_rearm(timer, now);
+	}
+
+	return 1;
+}
+
+/*
+ * Run every timer that is due, in expiry order, before asking for one
+ * reschedule at the end; callbacks only say whether they woke someone.
+ */
+static handler_return timer_softirq(void)
+{
+	timer_t			*timer;
+	struct timer_pass	 pass;
+	unsigned long		 now;
+	unsigned long long	 start;
+	enum handler_return	 ret = INT_NO_RESCHEDULE;
+	int			 soft = 0;
+
+	start = current_time_hires();
+	pass.nr_wanted = 0;
+	pass.nr_run    = 0;
+
+	enter_critical_section();
+	now = (unsigned long)current_time();
+	wheel_advance(now);
+
+	/* take one timer at a time, callbacks may add and delete others */
+	while (!list_empty(&timer_expired))
+	{
+		timer = list_first_entry(&timer_expired, timer_t, entry);
+		timer_wheel_del(timer);
+		timer_pass_count(&pass, timer);
+		timer_stats.expired++;
 
-		list_del(&timer->entry);
+		if (timer->flags & TIMER_SOFT)
+		{
+			soft |= timer_soft_queue(timer, now);
+			continue;
+		}
+		exit_critical_section();
 
-		
-		if (timer->function(timer, now, timer->arg) == INT_RESCHEDULE)
+		if (INT_RESCHEDULE == timer->function((struct timer *)timer, now, timer->arg))
 		{
 			ret = INT_RESCHEDULE;
-			return ret;
 		}
 
-		if (periodic_time && list_empty(&timer->entry))
+		enter_critical_section();
+		/* unless the callback deleted or re-added it */
+		if (timer->periodic_time && list_empty(&timer->entry))
+		{
+			timer_rearm(timer, now);
+		}
+	}
+
+	if (pass.nr_run)
+	{
+		timer_stats.passes++;
+		if (pass.nr_wanted > pass.nr_run)
 		{
-			timer->expired_time = now + periodic_time;
-			timer_list_add(timer);
+			timer_stats.wakeups_saved += pass.nr_wanted - pass.nr_run;
 		}
 	}
 
+	timer_next_valid = 0;
+	timer_program_next();
+	exit_critical_section();
+
+	if (soft)
+	{
+		/* flags need_resched, the task runs ahead of whoever was interrupted */
+		up(&timer_soft_wakeup);
+	}
+
+	timer_stats.softirq_time += current_time_hires() - start;
+
 	return ret;
 }
 
+/*
+ * Run the functions of soft timers in the order they fell due. Only
+ * claiming an entry masks interrupts, against timer_delete(); the
+ * function runs like any task code and may block. A timer deleted while
+ * its function runs here is not waited for. Each batch is a job of a
+ * sporadic deadline task, see TIMER_TASK_DEADLINE.
+ */
+static int timer_task(void *arg)
+{
+	struct timer_soft_entry	*e;
+	timer_t			*timer;
+	timer_function		 function = NULL;
+	void			*data	  = NULL;
+	unsigned long		 now;
+
+	task_set_deadline(current_task, TIMER_TASK_DEADLINE, 0);
+
+	while (1)
+	{
+		/* done with this job, the next wakeup gets a fresh deadline */
+		task_wait_period();
+		down(&timer_soft_wakeup);
+
+		while (timer_soft_tail != timer_soft_head)
+		{
+			e = &timer_soft_ring[timer_soft_tail % TIMER_SOFT_RING];
+
+			enter_critical_section();
+			timer = e->timer;
+			now   = e->now;
+			if (timer)
+			{
+				timer->flags &= ~TIMER_SOFT_QUEUED;
+				function      = timer->function;
+				data	      = timer->arg;
+			}
+			exit_critical_section();
+
+			/* done with the entry, the softirq may refill it */
+			barrier();
+			timer_soft_tail++;
+
+			if (timer && function)
+			{
+				function((struct timer *)timer, now, data);
+				timer_stats.soft_run++;
+			}
+		}
+	}
+
+	return 0;
+}
+
+TASK_DEFINE(timer, TIMER_TASK_PRIORITY, 0x800, timer_task);
+
+#ifdef CONFIG_TICKLESS
+/*
+ * Stop the periodic tick until the earliest timer is due. Only the idle
+ * task gets here, so there is nothing to time slice or account while
+ * the tick is off. Returns 1 if the tick was stopped.
+ */
+static int timer_stop_tick(void)
+{
+	unsigned long	 now = (unsigned long)current_time();
+	unsigned long	 next;
+	bigtime_t	 expires;
+
+	if (!timer_next_expiry(&next))
+	{
+		expires = ~0ULL;
+	}
+	else
+	{
+		if ((signed long)(next - now) < TICKLESS_MIN_IDLE)
+		{
+			return 0;
+		}
+		expires = current_time() + (next - now);
+	}
+
+	return platform_set_oneshot_timer(expires) != 0;
+}
+#endif
+
+/*
+ * Idle until the next interrupt, called from the idle loop with the
+ * critical section held. With CONFIG_TICKLESS the tick is stopped for
+ * the duration and restarted before any interrupt handler gets to run.
+ */
+void timer_idle(void)
+{
+	unsigned long long	 start;
+	#ifdef CONFIG_TICKLESS
+	int			 tickless = 0;
+	#endif
+
+	start = current_time_hires();
+
+	#ifdef CONFIG_TICKLESS
+	/* a running frame table is driven by the tick, keep it */
+	if (tickless_enabled && !cyclic_running())
+	{
+		tickless = timer_stop_tick();
+	}
+	#endif
+
+	arch_idle();
+
+	#ifdef CONFIG_TICKLESS
+	if (tickless)
+	{
+		idle_stats.tickless++;
+		if (platform_stop_oneshot_timer())
+		{
+			/* the one-shot interrupt is gone, run the timers it was for */
+			idle_stats.timer_wakeups++;
+			timer_tick(NULL, current_time());
+			do_softirq();
+		}
+	}
+	#endif
+
+	idle_stats.residency += current_time_hires() - start;
+	idle_stats.wakeups++;
+}
+
 void timer_init(void)
 {
-	INIT_LIST_HEAD(&timer_list);
+	int lvl, i;
+
+	for (i = 0; i < WHEEL_ROOT_SIZE; i++)
+	{
+		INIT_LIST_HEAD(&wheel_root[i]);
+	}
+	for (lvl = 0; lvl < WHEEL_LEVELS; lvl++)
+	{
+		for (i = 0; i < WHEEL_LVL_SIZE; i++)
+		{
+			INIT_LIST_HEAD(&wheel_lvl[lvl][i]);
+		}
+	}
+	wheel_clk = (unsigned long)current_time();
+
+	open_softirq(TIMER_SOFTIRQ, timer_softirq);
 
 	/* register for a periodic timer tick */
 	platform_set_periodic_timer((platform_timer_callback)timer_tick, NULL, 10); /* 10ms */
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2013 Yannik Li(Yanqing Li)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include <kernel/types.h>
+#include <kernel/task.h>
+#include <kernel/trace.h>
+
+/* power of two, the ring index is masked */
+#define TRACE_MASK	(TRACE_EVENTS - 1)
+
+/* off until "wakeuptrace on", tracing adds to the latency it measures */
+int			 wakeup_trace_enabled = 0;
+unsigned int		 wakeup_trace_prio    = WAKEUP_TRACE_DEFAULT_PRIO;
+struct wakeup_trace	 wakeup_trace_max;
+
+static struct trace_event	 trace_ring[TRACE_EVENTS];
+static unsigned int		 trace_head;
+
+void trace_event(int type, unsigned long arg)
+{
+	struct trace_event *e;
+
+	if (!wakeup_trace_enabled)
+	{
+		return;
+	}
+
+	e	= &trace_ring[trace_head++ & TRACE_MASK];
+	e->time = current_time_ns();
+	e->type = type;
+	e->pid	= current_task ? current_task->pid : 0;
+	e->arg	= arg;
+}
+
+/* called by the fifo class when a task is enqueued by a wakeup */
+void wakeup_trace_wakeup(task_t *p)
+{
+	if (p->priority > wakeup_trace_prio)
+	{
+		return;
+	}
+
+	trace_event(TRACE_WAKEUP, p->pid);
+	if (wakeup_trace_enabled)
+	{
+		p->trace_wakeup = trace_ring[(trace_head - 1) & TRACE_MASK].time;
+	}
+}
+
+/*
+ * Called by the fifo class with the task it is about to switch to. The
+ * wakeup time was stamped by wakeup_trace_wakeup(); a new worst case
+ * copies the ring, oldest event first, into wakeup_trace_max.
+ */
+void wakeup_trace_pick(task_t *p)
+{
+	unsigned long	 latency;
+	unsigned int	 nr;
+	unsigned int	 i;
+
+	if (!wakeup_trace_enabled || (p == current_task) || (0 == p->trace_wakeup) ||
+	    (p->priority > wakeup_trace_prio))
+	{
+		return;
+	}
+
+	trace_event(TRACE_SWITCH, p->pid);
+
+	latency = (unsigned long)(trace_ring[(trace_head - 1) & TRACE_MASK].time - p->trace_wakeup);
+	p->trace_wakeup = 0;
+	if (latency <= wakeup_trace_max.latency)
+	{
+		return;
+	}
+
+	nr = (trace_head < TRACE_EVENTS) ? trace_head : TRACE_EVENTS;
+	for (i = 0; i < nr; i++)
+	{
+		wakeup_trace_max.events[i] = trace_ring[(trace_head - nr + i) & TRACE_MASK];
+	}
+
+	wakeup_trace_max.nr_events = nr;
+	wakeup_trace_max.latency   = latency;
+	wakeup_trace_max.pid	   = p->pid;
+	wakeup_trace_max.priority  = p->priority;
+	strncpy(wakeup_trace_max.name, p->name, sizeof(wakeup_trace_max.name) - 1);
+	wakeup_trace_max.name[sizeof(wakeup_trace_max.name) - 1] = '\0';
+}
+
+void wakeup_trace_reset(void)
+{
+	enter_critical_section();
+	memset(&wakeup_trace_max, 0, sizeof(wakeup_trace_max));
+	trace_head = 0;
+	exit_critical_section();
+}
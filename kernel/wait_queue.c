@@ -26,24 +26,24 @@
 
 void __init_waitqueue_head(wait_queue_head_t *q, const char *name)
 {
-	sema_init(&q->lock, 1);
+	mutex_init(&q->lock);
 	INIT_LIST_HEAD(&q->task_list);
 }
 
 void add_wait_queue(wait_queue_head_t *q, wait_queue_t *wait)
 {
 	wait->flags &= ~WQ_FLAG_EXCLUSIVE;
-	down(&q->lock);
+	mutex_lock(&q->lock);
 	__add_wait_queue(q, wait);
-	up(&q->lock);
+	mutex_unlock(&q->lock);
 }
 
 void add_wait_queue_exclusive(wait_queue_head_t *q, wait_queue_t *wait)
 {
 	wait->flags |= WQ_FLAG_EXCLUSIVE;
-	down(&q->lock);
+	mutex_lock(&q->lock);
 	__add_wait_queue_tail(q, wait);
-	up(&q->lock);
+	mutex_unlock(&q->lock);
 }
 
 void remove_wait_queue(wait_queue_head_t *q, wait_queue_t *wait)
@@ -63,16 +63,26 @@ static void __wake_up_common(wait_queue_head_t *q, int nr_exclusive)
 	}
 }
 
+/*
+ * Wake the whole batch inside one critical section so that it costs a
+ * single switch to the highest priority waiter, see need_resched. The
+ * lock is dropped before that switch, the waiters take it again in
+ * finish_wait().
+ */
 void __wake_up(wait_queue_head_t *q, int nr_exclusive)
 {
-	down(&q->lock);
+	mutex_lock(&q->lock);
+	enter_critical_section();
 	__wake_up_common(q, nr_exclusive);
-	up(&q->lock);
+	mutex_unlock(&q->lock);
+	exit_critical_section();
 }
 
 void __wake_up_locked(wait_queue_head_t *q, int nr)
 {
+	enter_critical_section();
 	__wake_up_common(q, nr);
+	exit_critical_section();
 }
 
 void finish_wait(wait_queue_head_t *q, wait_queue_t *wait)
@@ -80,9 +90,9 @@ void finish_wait(wait_queue_head_t *q, wait_queue_t *wait)
 	set_current_state(RUNNING);
 
 	if (!list_empty_careful(&wait->task_list)) {
-		down(&q->lock);
+		mutex_lock(&q->lock);
 		list_del_init(&wait->task_list);
-		up(&q->lock);
+		mutex_unlock(&q->lock);
 	}
 }
 
@@ -1,4 +1,5 @@
 #include <kernel/list.h>
+#include <kernel/mutex.h>
 #include <kernel/semaphore.h>
 #include <kernel/wait_queue.h>
 #include <kernel/completion.h>
@@ -9,13 +10,19 @@
 #include <kernel/timer.h>
 #include <mm/malloc.h>
 
+/* delayed work may run this fraction of its delay late to share a wakeup */
+#define DELAYED_WORK_SLACK_DIV	32
+
 struct workqueue_struct {
-	struct semaphore	lock;
+	struct mutex		lock;
 	long			remove_sequence;
 	long			insert_sequence;
 	
 	struct list_head	worklist;
-	wait_queue_head_t	more_work;
+	/* expired delayed work, touched under a critical section only */
+	struct list_head	delayed;
+	/* up() for each queued work, it is safe from interrupt context */
+	struct semaphore	more_work;
 	wait_queue_head_t	work_done;
 
 	task_t			*task;
@@ -30,11 +37,11 @@ int queue_work(struct workqueue_struct *wq, struct work_struct *work)
 		assert(!list_empty(&work->entry));
 		work->wq_data = wq;
 
-		down(&wq->lock);
+		mutex_lock(&wq->lock);
 		list_add_tail(&work->entry, &wq->worklist);
 		wq->insert_sequence++;
-		wake_up(&wq->more_work);
-		up(&wq->lock);
+		up(&wq->more_work);
+		mutex_unlock(&wq->lock);
 		ret = 1;
 	}
 	
@@ -46,15 +53,26 @@ static enum handler_return delayed_work_timer_fn(timer_t *timer, unsigned long c
 	struct work_struct *work = (struct work_struct *)__data;
 	struct workqueue_struct *wq = work->wq_data;
 
-	down(&wq->lock);
-	list_add_tail(&work->entry, &wq->worklist);
-	wq->insert_sequence++;
-	wake_up(&wq->more_work);
-	up(&wq->lock);
+	/* may run in interrupt context, the worker moves it to the worklist */
+	enter_critical_section();
+	list_add_tail(&work->entry, &wq->delayed);
+	up(&wq->more_work);
+	exit_critical_section();
 
 	return INT_RESCHEDULE;
 }
 
+/* move expired delayed work onto the worklist, wq->lock held */
+static void take_delayed_work(struct workqueue_struct *wq)
+{
+	enter_critical_section();
+	while (!list_empty(&wq->delayed)) {
+		list_move_tail(wq->delayed.next, &wq->worklist);
+		wq->insert_sequence++;
+	}
+	exit_critical_section();
+}
+
 int queue_delayed_work(struct workqueue_struct *wq,
 		       struct work_struct *work, unsigned long delay)
 {
@@ -65,6 +83,8 @@ int queue_delayed_work(struct workqueue_struct *wq,
 		assert(!list_empty(&work->entry));
 
 		work->wq_data = wq;
+		/* nobody waits on the exact ms of delayed work */
+		timer_set_slack(timer, delay / DELAYED_WORK_SLACK_DIV);
 		oneshot_timer_add(timer, delay, (timer_function)delayed_work_timer_fn, work);
 		ret = 1;
 	}
@@ -74,24 +94,25 @@ int queue_delayed_work(struct workqueue_struct *wq,
 
 static inline void run_workqueue(struct workqueue_struct *wq)
 {
-	down(&wq->lock);
+	mutex_lock(&wq->lock);
+	take_delayed_work(wq);
 	while (!list_empty(&wq->worklist)) {
 		struct work_struct *work = list_entry(wq->worklist.next, struct work_struct, entry);
 		void (*f) (void *) = work->func;
 		void *data = work->data;
 
 		list_del_init(wq->worklist.next);
-		up(&wq->lock);
+		mutex_unlock(&wq->lock);
 
 		assert(work->wq_data != wq);
 		clear_bit(0, &work->pending);
 		f(data);
 
-		down(&wq->lock);
+		mutex_lock(&wq->lock);
 		wq->remove_sequence++;
 		wake_up(&wq->work_done);
 	}
-	up(&wq->lock);
+	mutex_unlock(&wq->lock);
 }
 
 typedef struct startup_s {
@@ -104,26 +125,19 @@ static int worker_thread(void *__startup)
 {
 	startup_t		*startup = __startup;
 	struct workqueue_struct *wq	 = startup->wq;
-	DECLARE_WAITQUEUE(wait, current_task);
 
 	wq->task = current_task;
 
 	complete(&startup->done);
 
 	for (;;) {
-		add_wait_queue(&wq->more_work, &wait);
+		down(&wq->more_work);
 
 		if (!wq->task)
 			break;
 
-		if (list_empty(&wq->worklist))
-			schedule_timeout(MAX_SCHEDULE_TIMEOUT);
-		remove_wait_queue(&wq->more_work, &wait);
-
-		if (!list_empty(&wq->worklist))
-			run_workqueue(wq);
+		run_workqueue(wq);
 	}
-	remove_wait_queue(&wq->more_work, &wait);
 	complete(&wq->exit);
 
 	return 0;
@@ -134,17 +148,18 @@ void flush_workqueue(struct workqueue_struct *wq)
 	DECLARE_WAITQUEUE(wait, current_task);
 	long sequence_needed;
 
-	down(&wq->lock);
+	mutex_lock(&wq->lock);
+	take_delayed_work(wq);
 	sequence_needed = wq->insert_sequence;
 
 	while (sequence_needed - wq->remove_sequence > 0) {
 		add_wait_queue(&wq->work_done, &wait);
-		up(&wq->lock);
+		mutex_unlock(&wq->lock);
 		schedule_timeout(MAX_SCHEDULE_TIMEOUT);
-		down(&wq->lock);
+		mutex_lock(&wq->lock);
 	}
 	finish_wait(&wq->work_done, &wait);
-	up(&wq->lock);
+	mutex_unlock(&wq->lock);
 }
 
 static int create_workqueue_thread(struct workqueue_struct *wq,
@@ -154,24 +169,27 @@ static int create_workqueue_thread(struct workqueue_struct *wq,
 	startup_t	 startup;
 	int		 ret;
 
-	sema_init(&wq->lock, 1);
+	mutex_init(&wq->lock);
 	wq->task = NULL;
 	wq->insert_sequence = 0;
 	wq->remove_sequence = 0;
 	INIT_LIST_HEAD(&wq->worklist);
-	init_waitqueue_head(&wq->more_work);
+	INIT_LIST_HEAD(&wq->delayed);
+	sema_init(&wq->more_work, 0);
 	init_waitqueue_head(&wq->work_done);
 	init_completion(&wq->exit);
 
 	init_completion(&startup.done);
 	startup.wq   = wq;
 	startup.name = name;
-	task_wq = task_alloc("workqueue", WQ_STACK_SIZE, 1);
+	task_wq = task_alloc("workqueue", WQ_STACK_SIZE, WQ_PRIORITY);
 	if (NULL == task_wq) {
 		return -1;
 	}
 	ret = task_create(task_wq, worker_thread, &startup);
 	if (0 == ret) {
+		/* destroy_workqueue() waits on wq->exit, nobody joins it */
+		task_detach(task_wq);
 		wait_for_completion(&startup.done);
 	}
 
@@ -198,7 +216,7 @@ static void cleanup_workqueue_task(struct workqueue_struct *wq)
 {
 	if (wq->task) {
 		wq->task = NULL;
-		wake_up(&wq->more_work);
+		up(&wq->more_work);
 		wait_for_completion(&wq->exit);
 	}
 }
@@ -104,7 +104,7 @@ void page_alloc_init(uint32_t *addr, uint32_t size) {
 	used_pages	    = ((zone->spanned_pages * sizeof(struct page)) >> PAGE_SHIFT) + 1;
 	zone->managed_pages = zone->spanned_pages - used_pages;
 
-	sema_init(&zone->lock, 1);
+	mutex_init(&zone->lock);
 	
 	memmap_pages = (struct page *)addr;
 	
@@ -201,9 +201,9 @@ struct page *alloc_pages(size_t size) {
 		return NULL;
 	}
 
-	down(&zone->lock);
+	mutex_lock(&zone->lock);
 	page = __rmqueue(zone, order);
-	up(&zone->lock);
+	mutex_unlock(&zone->lock);
 
 	/* print_free_list(); */
 	return page;
@@ -257,9 +257,9 @@ static inline void free_one_page(struct zone *zone,
 void __free_pages(struct page *page, unsigned int order) {
 	struct zone *zone = &zones[ZONE_NORMAL];
 
-	down(&zone->lock);
+	mutex_lock(&zone->lock);
 	free_one_page(zone, page, order);
-	up(&zone->lock);
+	mutex_unlock(&zone->lock);
 }
 
 struct page *virt_to_page(void *addr) {
@@ -26,6 +26,7 @@
 #include <arch/arch.h>
 #include <mm/page_alloc.h>
 #include <mm/slob.h>
+#include <kernel/mutex.h>
 
 static LIST_HEAD(free_slob_small);
 static LIST_HEAD(free_slob_medium);
@@ -58,7 +59,7 @@ static inline void clear_slob_page_free(struct page *sp)
 	__ClearPageSlobFree(sp);
 }
 
-DEFINE_SEMAPHORE(sem);
+DEFINE_MUTEX(slob_lock);
 
 static void set_slob(slob_t *s, slobidx_t size, slob_t *next)
 {
@@ -184,7 +185,7 @@ void *slob_alloc(size_t size, int align) {
 	else
 		slob_list = &free_slob_large;
 
-	down(&sem);
+	mutex_lock(&slob_lock);
 
 	list_for_each_entry(sp, slob_list, list) {
 		if (sp->units < SLOB_UNITS(size))
@@ -204,7 +205,7 @@ void *slob_alloc(size_t size, int align) {
 		break;
 	}
 	
-	up(&sem);
+	mutex_unlock(&slob_lock);
 
 	if (!b) {
 		b = slob_new_pages(PAGE_SIZE-1);
@@ -212,7 +213,7 @@ void *slob_alloc(size_t size, int align) {
 			return NULL;
 		sp = virt_to_page(b);
 		
-		down(&sem);
+		mutex_lock(&slob_lock);
 		sp->units = SLOB_UNITS(PAGE_SIZE);
 		sp->freelist = b;
 		INIT_LIST_HEAD(&sp->list);
@@ -220,7 +221,7 @@ void *slob_alloc(size_t size, int align) {
 		set_slob_page_free(sp, slob_list);
 		b = slob_page_alloc(sp, size, align);
 
-		up(&sem);
+		mutex_unlock(&slob_lock);
 	}
 	
 	return b;
@@ -235,13 +236,13 @@ void slob_free(void *block, int size) {
 	sp = virt_to_page(block);
 	units = SLOB_UNITS(size);
 	
-	down(&sem);
+	mutex_lock(&slob_lock);
 
 	if (sp->units + units == SLOB_UNITS(PAGE_SIZE)) {
 		/* Go directly to page allocator. Do not pass slob allocator */
 		if (slob_page_free(sp))
 			clear_slob_page_free(sp);
-		up(&sem);
+		mutex_unlock(&slob_lock);
 		sp->_mapcount = -1;
 		slob_free_pages(b);
 		return;
@@ -300,5 +301,5 @@ void slob_free(void *block, int size) {
 			set_slob(prev, slob_units(prev), b);
 	}
 out:
-	up(&sem);
+	mutex_unlock(&slob_lock);
 }